@@ -0,0 +1,103 @@
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <memory_resource>
+
+#include "arena.h"
+
+namespace {
+    thread_local Arena* currentArena = nullptr;
+
+    std::size_t roundUp(std::size_t n, std::size_t to) {
+        return (n + to - 1) / to * to;
+    }
+}
+
+Arena::Arena(std::size_t blockSize):
+    freeLists(maxPooledSize / granularity + 1, nullptr), blockSize{blockSize} {}
+
+Arena::~Arena() {
+    for (char* block : blocks) std::free(block);
+}
+
+void* Arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    bytes = roundUp(bytes > 0 ? bytes : 1, granularity);
+    bytesInUse.store(bytesInUse.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+
+    // reuse a freed chunk of the same size class if there is one
+    if (bytes <= maxPooledSize && alignment <= granularity) {
+        void*& head = freeLists[bytes / granularity];
+        if (head) {
+            void* p = head;
+            head = *static_cast<void**>(p);
+            return p;
+        }
+    }
+
+    // otherwise bump the pointer, starting a new block if needed
+    std::uintptr_t aligned = roundUp(reinterpret_cast<std::uintptr_t>(curr), alignment);
+    if (!curr || aligned + bytes > reinterpret_cast<std::uintptr_t>(end)) {
+        std::size_t size = bytes + alignment > blockSize ? bytes + alignment : blockSize;
+        char* block = static_cast<char*>(std::malloc(size));
+        if (!block) throw std::bad_alloc{};
+        blocks.emplace_back(block);
+        bytesReserved.store(bytesReserved.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+        curr = block;
+        end = block + size;
+        aligned = roundUp(reinterpret_cast<std::uintptr_t>(curr), alignment);
+    }
+    curr = reinterpret_cast<char*>(aligned + bytes);
+    return reinterpret_cast<void*>(aligned);
+}
+
+void Arena::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+    bytes = roundUp(bytes > 0 ? bytes : 1, granularity);
+    bytesInUse.store(bytesInUse.load(std::memory_order_relaxed) - bytes, std::memory_order_relaxed);
+
+    // chunks too large to pool stay reserved until the arena is destroyed
+    if (bytes <= maxPooledSize) {
+        void*& head = freeLists[bytes / granularity];
+        *static_cast<void**>(p) = head;
+        head = p;
+    }
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+std::size_t Arena::getBytesInUse() const {return bytesInUse.load(std::memory_order_relaxed);}
+
+std::size_t Arena::getBytesReserved() const {return bytesReserved.load(std::memory_order_relaxed);}
+
+std::size_t Arena::chunkSize(std::size_t bytes) {return roundUp(bytes > 0 ? bytes : 1, granularity);}
+
+Arena* Arena::current() {return currentArena;}
+
+std::pmr::memory_resource* Arena::resource() {
+    return currentArena ? static_cast<std::pmr::memory_resource*>(currentArena) : std::pmr::new_delete_resource();
+}
+
+Arena::Scope::Scope(Arena* arena): prev{currentArena} {currentArena = arena;}
+
+Arena::Scope::~Scope() {currentArena = prev;}
+
+namespace {
+    constexpr std::size_t headerSize = alignof(std::max_align_t);
+}
+
+void* ArenaAllocated::operator new(std::size_t size) {
+    Arena* arena = currentArena;
+    char* p = static_cast<char*>(arena ? arena->allocate(size + headerSize) : ::operator new(size + headerSize));
+    *reinterpret_cast<Arena**>(p) = arena;
+    return p + headerSize;
+}
+
+void ArenaAllocated::operator delete(void* p, std::size_t size) {
+    char* start = static_cast<char*>(p) - headerSize;
+    Arena* arena = *reinterpret_cast<Arena**>(start);
+    if (arena) arena->deallocate(start, size + headerSize);
+    else ::operator delete(start);
+}
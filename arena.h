@@ -0,0 +1,113 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <vector>
+#include <memory_resource>
+
+// A slab allocator: memory is bump-allocated from large blocks, freed
+//   chunks are kept on per-size free lists for reuse, and all blocks
+//   are released at once when the arena is destroyed. An arena must
+//   only allocate and deallocate from one thread at a time.
+class Arena final : public std::pmr::memory_resource {
+
+    private:
+        static constexpr std::size_t granularity = 16;
+        static constexpr std::size_t maxPooledSize = 1 << 16;
+        static constexpr std::size_t defaultBlockSize = 1 << 20;
+
+        std::vector<char*> blocks;
+        std::vector<void*> freeLists;
+        char* curr = nullptr;
+        char* end = nullptr;
+
+        std::size_t blockSize;
+
+        // only the owning thread writes these, but any thread may read them
+        std::atomic<std::size_t> bytesReserved{0};
+        std::atomic<std::size_t> bytesInUse{0};
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    public:
+        explicit Arena(std::size_t blockSize = defaultBlockSize);
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // Construct an object of type T in memory taken from the
+        //   arena. The object is never destroyed when the arena is,
+        //   so it must either be destroyed explicitly with destroy()
+        //   or own no memory outside of the arena.
+        template<typename T, typename... Args>
+        T* make(Args&&... args) {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Construct n default-initialized objects of type T
+        //   contiguously in memory taken from the arena.
+        template<typename T>
+        T* makeArray(std::size_t n) {
+            return new (allocate(sizeof(T) * n, alignof(T))) T[n];
+        }
+
+        // Destroy an object constructed with make(), returning its
+        //   memory to the arena so it can be reused.
+        template<typename T>
+        void destroy(T* p) {
+            p->~T();
+            deallocate(p, sizeof(T), alignof(T));
+        }
+
+        // Return the number of bytes handed out by the arena that
+        //   have not yet been returned to it.
+        std::size_t getBytesInUse() const;
+
+        // Return the number of bytes the arena has reserved from
+        //   the system, including bytes not yet handed out.
+        std::size_t getBytesReserved() const;
+
+        // Return the number of bytes an allocation of the given size
+        //   takes from the arena.
+        static std::size_t chunkSize(std::size_t bytes);
+
+        // Return the arena that objects deriving from ArenaAllocated
+        //   are currently allocated in by the calling thread, or
+        //   nullptr if they are allocated on the heap.
+        static Arena* current();
+
+        // Return the memory resource that containers should allocate
+        //   from on the calling thread: the current arena if there is
+        //   one, otherwise the default heap resource.
+        static std::pmr::memory_resource* resource();
+
+        // Makes the given arena current on the calling thread for
+        //   the lifetime of the scope object.
+        class Scope final {
+            private:
+                Arena* prev;
+            public:
+                explicit Scope(Arena* arena);
+                ~Scope();
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+        };
+};
+
+// Base for classes whose objects are created with plain new by
+//   client code (e.g. Skill::copy()), but should be placed in the
+//   current arena when there is one. Each object carries a small
+//   header recording where it was allocated so that delete returns
+//   the memory to the right place.
+struct ArenaAllocated {
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+};
+
+#endif
@@ -0,0 +1,466 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "state.h"
+#include "node.h"
+#include "rollout.h"
+#include "solver.h"
+#include "beam.h"
+#include "bm.h"
+#include "synthetic.h"
+#include "table_kit.h"
+
+// Runs a list of search scenarios, as many at once as a budget of
+//   cores allows, and prints one table of their results: the best
+//   rotation, its DPS, the number of playouts (or of states searched,
+//   for the beam and the solver), the wall time and the peak RSS of
+//   every scenario. Each scenario runs in a process of its own, so
+//   that its peak RSS is its own, and a scenario running out of memory
+//   fails alone.
+//
+// The scenario list has one scenario per line, as space-separated
+//   key=value settings, any of which may be a comma-separated list of
+//   values to sweep: the line then stands for every combination of
+//   them, in order. Blank lines and everything after a '#' are
+//   ignored. The settings, with their defaults, are
+//
+//     name=                 the name in the table, followed by the
+//                           values swept; the settings given if empty
+//     kit=bm                bm, bm-static, syntheticN, syntheticN-table
+//                           or syntheticN-clock, as in bench, or the path
+//                           of a kit file (see table_kit.h)
+//     clock=0               1 to run kit files on a clock (see TableKit)
+//     mode=tree             tree, beam or solve (see main.cc)
+//     cpuct=1 playouts=100000 threads=1 seed=1
+//     fight-length=0        180 seconds for the beam and the solver
+//     rollouts=0 rollout-policy=greedy
+//     expected-damage=0 flat=0 transpositions=0
+//     widening=0 widening-exponent=0.5 prune-waiting=0
+//     beam-width=64 max-damage-rate=0
+//
+//   for example
+//
+//     kit=bm cpuct=0.5,1,2,4 playouts=100000,1000000 threads=2
+//     kit=bm mode=solve fight-length=10000,20000
+//
+// A scenario is started as soon as the cores it uses (its number of
+//   threads, cut down to the budget) are free, in the order of the
+//   list.
+//
+// Usage: batch [--cores=N] [--output=table|csv|json] FILE
+
+namespace {
+
+    struct Scenario {
+        std::string name = "";
+        std::string kit = "bm";
+        bool clock = false;
+        std::string mode = "tree";
+        double cPUCT = 1;
+        long numPlayouts = 100000;
+        int numThreads = 1;
+        unsigned seed = 1;
+        int fightLength = 0;
+        int rollouts = 0;
+        std::string rolloutPolicy = "greedy";
+        bool expectedDamage = false;
+        bool flatStates = false;
+        bool transpositions = false;
+        double wideningFactor = 0;
+        double wideningExponent = 0.5;
+        bool pruneWaiting = false;
+        int beamWidth = 64;
+        double maxDamageRate = 0;
+    };
+
+    struct Result {
+        std::string error = "";
+        std::string rotation = "";
+        double dps = 0;
+        long numPlayouts = 0;
+        double seconds = 0;
+        long peakRss = 0;
+    };
+
+    std::unique_ptr<State> makeState(const std::string& kit, unsigned seed, bool clock) {
+        if (kit == "bm") return BM::makeState();
+        if (kit == "bm-static") return BM::makeStaticState();
+        std::string error;
+        std::size_t digits = kit.find_first_not_of("0123456789", 9);
+        if (kit.rfind("synthetic", 0) == 0 && kit.size() > 9 && digits > 9) {
+            std::string suffix = digits == std::string::npos ? "" : kit.substr(digits);
+            if (suffix.empty()) return Synthetic::makeState(std::stoi(kit.substr(9)), seed);
+            if (suffix == "-table" || suffix == "-clock") {
+                std::istringstream file{Synthetic::describe(std::stoi(kit.substr(9)), seed)};
+                return TableKit::parse(file, error, clock || suffix == "-clock");
+            }
+        }
+        return TableKit::load(kit, error, clock);
+    }
+
+    // Apply one setting to the scenario, returning false if the key,
+    //   or the value, is not one of those listed above. Kits are
+    //   checked by parse().
+    bool set(Scenario& scenario, const std::string& key, const std::string& value) {
+        try {
+            if (key == "name") scenario.name = value;
+            else if (key == "kit") scenario.kit = value;
+            else if (key == "clock") scenario.clock = std::stoi(value);
+            else if (key == "mode") scenario.mode = value;
+            else if (key == "cpuct") scenario.cPUCT = std::stod(value);
+            else if (key == "playouts") scenario.numPlayouts = std::stol(value);
+            else if (key == "threads") scenario.numThreads = std::max(std::stoi(value), 1);
+            else if (key == "seed") scenario.seed = std::stoul(value);
+            else if (key == "fight-length") scenario.fightLength = std::stoi(value);
+            else if (key == "rollouts") scenario.rollouts = std::stoi(value);
+            else if (key == "rollout-policy") scenario.rolloutPolicy = value;
+            else if (key == "expected-damage") scenario.expectedDamage = std::stoi(value);
+            else if (key == "flat") scenario.flatStates = std::stoi(value);
+            else if (key == "transpositions") scenario.transpositions = std::stoi(value);
+            else if (key == "widening") scenario.wideningFactor = std::stod(value);
+            else if (key == "widening-exponent") scenario.wideningExponent = std::stod(value);
+            else if (key == "prune-waiting") scenario.pruneWaiting = std::stoi(value);
+            else if (key == "beam-width") scenario.beamWidth = std::stoi(value);
+            else if (key == "max-damage-rate") scenario.maxDamageRate = std::stod(value);
+            else return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (scenario.mode != "tree" && scenario.mode != "beam" && scenario.mode != "solve") return false;
+        if (scenario.rolloutPolicy != "greedy" && scenario.rolloutPolicy != "random") return false;
+        return true;
+    }
+
+    // Add every scenario of the given line to the list, returning false
+    //   with a message if a setting is not valid. Kits not yet in the
+    //   set of checked kits are checked by loading them, and added.
+    bool parse(const std::string& line, std::vector<Scenario>& scenarios, std::string& error,
+               std::set<std::string>& checkedKits) {
+        std::vector<std::string> keys;
+        std::vector<std::vector<std::string>> values;
+        std::istringstream tokens{line.substr(0, line.find('#'))};
+        for (std::string token; tokens >> token;) {
+            std::size_t equals = token.find('=');
+            if (equals == std::string::npos) {
+                error = "expected key=value, got " + token;
+                return false;
+            }
+            keys.emplace_back(token.substr(0, equals));
+            values.emplace_back();
+            std::istringstream list{token.substr(equals + 1)};
+            for (std::string value; std::getline(list, value, ',');) values.back().emplace_back(value);
+            if (values.back().empty()) values.back().emplace_back("");
+        }
+        if (keys.empty()) return true;
+
+        // loading a kit file is slow, so every kit is checked once
+        //   rather than with every combination it is part of
+        for (std::size_t k = 0; k < keys.size(); k++) {
+            if (keys[k] != "kit") continue;
+            for (const std::string& kit : values[k]) {
+                if (checkedKits.count(kit)) continue;
+                if (!makeState(kit, 1, false)) {
+                    error = "invalid setting kit=" + kit;
+                    return false;
+                }
+                checkedKits.insert(kit);
+            }
+        }
+
+        // count through every combination, the last setting changing
+        //   fastest
+        std::vector<std::size_t> choice(keys.size(), 0);
+        while (true) {
+            Scenario scenario;
+            std::string settings = "", swept = "";
+            for (std::size_t k = 0; k < keys.size(); k++) {
+                const std::string& value = values[k][choice[k]];
+                if (!set(scenario, keys[k], value)) {
+                    error = "invalid setting " + keys[k] + "=" + value;
+                    return false;
+                }
+                if (keys[k] == "name") continue;
+                settings += (settings.empty() ? "" : " ") + keys[k] + "=" + value;
+                if (values[k].size() > 1) swept += " " + keys[k] + "=" + value;
+            }
+            scenario.name = scenario.name.empty() ? settings : scenario.name + swept;
+            scenarios.emplace_back(scenario);
+
+            std::size_t k = keys.size();
+            while (k > 0 && ++choice[k - 1] == values[k - 1].size()) choice[--k] = 0;
+            if (k == 0) break;
+        }
+        return true;
+    }
+
+    // Run the scenario, filling the rotation, the DPS and the number of
+    //   playouts of the result
+    void run(const Scenario& scenario, Result& result) {
+        std::unique_ptr<State> state = makeState(scenario.kit, scenario.seed, scenario.clock);
+        int fightLength = scenario.fightLength ? scenario.fightLength : 180000;
+
+        if (scenario.mode == "beam") {
+            BeamOptions options;
+            options.fightLength = fightLength;
+            options.width = scenario.beamWidth;
+            options.numThreads = scenario.numThreads;
+            options.seed = scenario.seed;
+            Solution solution;
+            BeamSearch::search(*state, options, solution);
+            result.rotation = solution.rotation;
+            result.dps = solution.dps;
+            result.numPlayouts = solution.numStates;
+            return;
+        }
+        if (scenario.mode == "solve") {
+            SolverOptions options;
+            options.fightLength = fightLength;
+            options.numThreads = scenario.numThreads;
+            options.maxDamageRate = scenario.maxDamageRate;
+            Solution solution;
+            if (!Solver::solve(*state, options, solution)) {
+                result.error = "every skill must declare its damage distribution";
+                return;
+            }
+            result.rotation = solution.rotation;
+            result.dps = solution.dps;
+            result.numPlayouts = solution.numStates;
+            return;
+        }
+
+        SearchOptions options;
+        options.numThreads = scenario.numThreads;
+        options.seed = scenario.seed;
+        options.fightLength = scenario.fightLength;
+        options.rollouts = scenario.rollouts;
+        if (scenario.rolloutPolicy == "random") options.rolloutPolicy = std::make_shared<RandomRollout>();
+        options.expectedDamage = scenario.expectedDamage;
+        options.flatStates = scenario.flatStates;
+        options.transpositions = scenario.transpositions;
+        options.wideningFactor = scenario.wideningFactor;
+        options.wideningExponent = scenario.wideningExponent;
+        options.pruneWaiting = scenario.pruneWaiting;
+        Node root;
+        root.setState(std::move(state));
+        root.setOptions(options);
+
+        std::atomic<long> claimed{0};
+        auto work = [&](int thread) {
+            while (claimed.fetch_add(1, std::memory_order_relaxed) < scenario.numPlayouts) {
+                root.playout(scenario.cPUCT, thread);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int t = 1; t < scenario.numThreads; t++) workers.emplace_back(work, t);
+        work(0);
+        for (auto it = workers.begin(); it != workers.end(); ++it) it->join();
+
+        std::pair<std::string, double> best = root.currentBestPath();
+        result.rotation = best.first;
+        result.dps = best.second;
+        result.numPlayouts = scenario.numPlayouts;
+    }
+
+    // A scenario running in a child process, which writes its result
+    //   to a pipe: the DPS, the number of playouts and an error message
+    //   on a line, then the rotation
+    struct Running {
+        std::size_t index;
+        pid_t pid;
+        int fd;
+        int cores;
+        std::string output;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    bool start(const std::vector<Scenario>& scenarios, std::size_t index, int cores, std::vector<Running>& running) {
+        int fds[2];
+        if (pipe(fds) != 0) return false;
+        std::fflush(stdout);
+        std::fflush(stderr);
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            Result result;
+            run(scenarios[index], result);
+            std::ostringstream out;
+            out.precision(17);
+            out << result.dps << " " << result.numPlayouts << " " << result.error << "\n" << result.rotation;
+            std::string message = out.str();
+            for (std::size_t written = 0; written < message.size();) {
+                ssize_t n = write(fds[1], message.data() + written, message.size() - written);
+                if (n <= 0) _exit(1);
+                written += n;
+            }
+            _exit(0);
+        }
+        close(fds[1]);
+        running.emplace_back(Running{index, pid, fds[0], cores, "", std::chrono::steady_clock::now()});
+        return true;
+    }
+
+    // Reap the child of the running scenario, whose pipe was closed,
+    //   and fill in its result
+    void finish(Running& scenario, Result& result) {
+        int status = 0;
+        struct rusage usage;
+        wait4(scenario.pid, &status, 0, &usage);
+        close(scenario.fd);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - scenario.start).count();
+        result.peakRss = usage.ru_maxrss * 1024L;
+        if (WIFSIGNALED(status)) {
+            result.error = std::string{"killed by "} + strsignal(WTERMSIG(status));
+            return;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            result.error = "exited with status " + std::to_string(WEXITSTATUS(status));
+            return;
+        }
+        std::size_t newline = scenario.output.find('\n');
+        std::istringstream header{scenario.output.substr(0, newline)};
+        header >> result.dps >> result.numPlayouts;
+        std::getline(header >> std::ws, result.error);
+        if (newline != std::string::npos) result.rotation = scenario.output.substr(newline + 1);
+    }
+
+    std::string quoted(const std::string& s) {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    void print(const std::vector<Scenario>& scenarios, const std::vector<Result>& results, const std::string& output) {
+        if (output == "csv") std::printf("name,dps,playouts,seconds,peak_rss_mb,rotation,error\n");
+        int width = 4;
+        for (const Scenario& scenario : scenarios) width = std::max(width, static_cast<int>(scenario.name.size()));
+        if (output == "table") {
+            std::printf("%-*s  %9s  %12s  %9s  %11s  %s\n", width, "Name", "DPS", "Playouts", "Seconds", "Peak RSS MB",
+                        "Best Rotation");
+        }
+
+        for (std::size_t i = 0; i < scenarios.size(); i++) {
+            const Result& r = results[i];
+            const char* name = scenarios[i].name.c_str();
+            double rss = r.peakRss / 1048576.0;
+            if (output == "json") {
+                std::printf("{\"name\": %s, \"dps\": %.6f, \"playouts\": %ld, \"seconds\": %.6f, \"peak_rss_mb\": %.1f, "
+                            "\"rotation\": %s, \"error\": %s}\n",
+                            quoted(scenarios[i].name).c_str(), r.dps, r.numPlayouts, r.seconds, rss,
+                            quoted(r.rotation).c_str(), quoted(r.error).c_str());
+            } else if (output == "csv") {
+                std::printf("%s,%.6f,%ld,%.6f,%.1f,%s,%s\n", quoted(scenarios[i].name).c_str(), r.dps, r.numPlayouts,
+                            r.seconds, rss, quoted(r.rotation).c_str(), quoted(r.error).c_str());
+            } else if (!r.error.empty()) {
+                std::printf("%-*s  %9s  %12s  %9.2f  %11.1f  %s\n", width, name, "-", "-", r.seconds, rss,
+                            ("failed: " + r.error).c_str());
+            } else {
+                std::printf("%-*s  %9.6f  %12ld  %9.2f  %11.1f  %s\n", width, name, r.dps, r.numPlayouts, r.seconds, rss,
+                            r.rotation.c_str());
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int budget = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string output = "table", path = "";
+    for (int i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+        if (arg.rfind("--cores=", 0) == 0) budget = std::max(std::stoi(arg.substr(8)), 1);
+        else if (arg == "--output=table" || arg == "--output=csv" || arg == "--output=json") output = arg.substr(9);
+        else if (arg.rfind("--", 0) != 0 && path.empty()) path = arg;
+        else {
+            std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+            return 1;
+        }
+    }
+    if (path.empty()) {
+        std::fprintf(stderr, "Usage: batch [--cores=N] [--output=table|csv|json] FILE\n");
+        return 1;
+    }
+
+    std::ifstream file{path};
+    if (!file) {
+        std::fprintf(stderr, "Could not open %s\n", path.c_str());
+        return 1;
+    }
+    std::vector<Scenario> scenarios;
+    std::set<std::string> checkedKits;
+    std::string line, error;
+    for (int number = 1; std::getline(file, line); number++) {
+        if (!parse(line, scenarios, error, checkedKits)) {
+            std::fprintf(stderr, "%s:%d: %s\n", path.c_str(), number, error.c_str());
+            return 1;
+        }
+    }
+
+    for (Scenario& scenario : scenarios) scenario.numThreads = std::min(scenario.numThreads, budget);
+
+    // children that fail to write their result must not kill the batch
+    signal(SIGPIPE, SIG_IGN);
+    std::vector<Result> results(scenarios.size());
+    std::vector<Running> running;
+    std::size_t next = 0, numDone = 0;
+    int freeCores = budget;
+    std::vector<pollfd> fds;
+    while (numDone < scenarios.size()) {
+        while (next < scenarios.size()) {
+            int cores = scenarios[next].numThreads;
+            if (cores > freeCores) break;
+            if (!start(scenarios, next, cores, running)) {
+                std::fprintf(stderr, "Could not start scenario %s\n", scenarios[next].name.c_str());
+                return 1;
+            }
+            freeCores -= cores;
+            next++;
+        }
+
+        fds.clear();
+        for (const Running& scenario : running) fds.emplace_back(pollfd{scenario.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0) continue;
+        char buffer[4096];
+        for (std::size_t i = fds.size(); i-- > 0;) {
+            if (!fds[i].revents) continue;
+            ssize_t n = read(running[i].fd, buffer, sizeof(buffer));
+            if (n > 0 || (n < 0 && errno == EINTR)) {
+                if (n > 0) running[i].output.append(buffer, n);
+                continue;
+            }
+            Result& result = results[running[i].index];
+            finish(running[i], result);
+            freeCores += running[i].cores;
+            numDone++;
+            std::fprintf(stderr, "[%zu/%zu] %s: %s in %.2f s\n", numDone, scenarios.size(),
+                         scenarios[running[i].index].name.c_str(), result.error.empty() ? "done" : "failed",
+                         result.seconds);
+            running.erase(running.begin() + i);
+        }
+    }
+
+    print(scenarios, results, output);
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rng.h"
+#include "skill.h"
+#include "state.h"
+#include "solver.h"
+#include "beam.h"
+
+namespace {
+
+    // A partial rotation, holding the decision that extended it (the
+    //   index of the partial rotation it extends in the previous beam,
+    //   and the skill used, -1 for waiting) and the state it reaches,
+    //   as a snapshot if states support them, otherwise as a copy
+    struct Candidate {
+        int parent;
+        int skill;
+        int elapsed;
+        double damage;
+        double score;
+        std::string snapshot;
+        std::unique_ptr<State> state;
+    };
+
+    struct Action {
+        int skill;
+        int time;
+        double damage;
+    };
+
+    // Per-thread scratch space, along with the partial rotations the
+    //   thread extended in the current step
+    struct Scratch {
+        std::unique_ptr<State> state;
+        std::vector<int> availableSkills;
+        std::vector<Action> actions;
+        std::vector<DamageOutcome> outcomes;
+        Rng rng;
+        std::vector<Candidate> children;
+    };
+
+    class Beam final {
+        private:
+            const BeamOptions& options;
+            bool flat;
+            bool expected;
+
+        public:
+            Beam(const State& root, const BeamOptions& options, bool expected):
+                options{options}, flat{root.getSnapshotSize() > 0}, expected{expected} {}
+
+            double damage(const State& state, int index, Scratch& scratch) const;
+            double score(int elapsed, double damage) const;
+            void extend(const std::vector<Candidate>& beam, int index, Scratch& scratch) const;
+            std::size_t key(const Candidate& candidate) const;
+            bool equal(const Candidate& a, const Candidate& b) const;
+    };
+
+    double Beam::damage(const State& state, int index, Scratch& scratch) const {
+        if (!expected) return state.getDamage(index, scratch.rng);
+        state.getDamageDistribution(index, scratch.outcomes);
+        double total = 0;
+        for (const DamageOutcome& outcome : scratch.outcomes) total += outcome.damage * outcome.probability;
+        return total;
+    }
+
+    // The damage dealt so far per unit of time. Partial rotations are
+    //   extended by one decision at a time, so those in a beam do not
+    //   all end at the same time. Adding the time left at the best rate
+    //   of any skill instead overrates states with strong skills still
+    //   on cooldown, and gets worse as the beam grows.
+    double Beam::score(int elapsed, double damage) const {
+        return elapsed ? damage / elapsed : 0;
+    }
+
+    // Adds to the scratch space every extension of the partial rotation
+    //   at the given index of the beam
+    void Beam::extend(const std::vector<Candidate>& beam, int index, Scratch& scratch) const {
+        const Candidate& candidate = beam[index];
+        const State* state = candidate.state.get();
+        if (flat) {
+            scratch.state->loadSnapshot(candidate.snapshot.data());
+            state = scratch.state.get();
+        }
+        state->getAvailableSkills(scratch.availableSkills);
+        scratch.actions.clear();
+        for (int skill : scratch.availableSkills) {
+            scratch.actions.emplace_back(Action{skill, state->getCastTime(skill), damage(*state, skill, scratch)});
+        }
+        scratch.actions.emplace_back(Action{-1, state->getWaitTime(), 0});
+
+        for (const Action& action : scratch.actions) {
+            Candidate child{index, action.skill, candidate.elapsed + action.time, candidate.damage + action.damage, 0,
+                            std::string{}, nullptr};
+            State* next;
+            if (flat) {
+                scratch.state->loadSnapshot(candidate.snapshot.data());
+                next = scratch.state.get();
+            } else {
+                child.state.reset(candidate.state->copy());
+                next = child.state.get();
+            }
+            next->useSkill(action.skill, action.time);
+            if (flat) {
+                child.snapshot.resize(candidate.snapshot.size());
+                next->saveSnapshot(&child.snapshot[0]);
+            }
+            child.score = score(child.elapsed, child.damage);
+            scratch.children.emplace_back(std::move(child));
+        }
+    }
+
+    std::size_t Beam::key(const Candidate& candidate) const {
+        std::size_t h = flat ? std::hash<std::string>{}(candidate.snapshot) : candidate.state->hash();
+        return h ^ (static_cast<std::size_t>(candidate.elapsed) * 0x9e3779b97f4a7c15ULL);
+    }
+
+    bool Beam::equal(const Candidate& a, const Candidate& b) const {
+        return a.elapsed == b.elapsed && (flat ? a.snapshot == b.snapshot : a.state->equals(*b.state));
+    }
+}
+
+void BeamSearch::search(const State& state, const BeamOptions& options, Solution& solution) {
+    std::vector<DamageOutcome> outcomes;
+    bool expected = true;
+    for (int i = 0; i < state.getNumSkills() && expected; i++) expected = state.getDamageDistribution(i, outcomes);
+    Beam beam{state, options, expected};
+    bool flat = state.getSnapshotSize() > 0;
+
+    int numThreads = std::max(options.numThreads, 1);
+    std::vector<Scratch> scratches(numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        scratches[t].state.reset(state.copy());
+        scratches[t].rng.seed(options.seed, t);
+    }
+
+    std::vector<Candidate> current;
+    current.emplace_back(Candidate{-1, -1, 0, 0, 0, std::string{}, nullptr});
+    if (flat) {
+        current[0].snapshot.resize(state.getSnapshotSize());
+        state.saveSnapshot(&current[0].snapshot[0]);
+    } else {
+        current[0].state.reset(state.copy());
+    }
+
+    // the decisions of every kept partial rotation at every step, to
+    //   rebuild the best one at the end. Rotations that reach the end
+    //   of the fight leave the beam before it is cut to its width, the
+    //   best one found being kept aside, so that they are not crowded
+    //   out by partial rotations with more optimistic scores.
+    std::vector<std::vector<std::pair<int, int>>> steps;
+    int bestStep = -1;
+    std::pair<int, int> bestDecision;
+    solution = Solution{};
+    std::vector<Candidate> children;
+    std::vector<int> order;
+    std::unordered_multimap<std::size_t, int> seen;
+    while (!current.empty()) {
+
+        // every thread extends every numThreads-th partial rotation
+        for (Scratch& scratch : scratches) scratch.children.clear();
+        auto work = [&](int t) {
+            for (int i = t; i < static_cast<int>(current.size()); i += numThreads) beam.extend(current, i, scratches[t]);
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < numThreads && t < static_cast<int>(current.size()); t++) threads.emplace_back(work, t);
+        work(0);
+        for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+
+        // merge partial rotations reaching the same state at the same
+        //   time, keeping the one that dealt the most damage
+        children.clear();
+        seen.clear();
+        for (int t = 0; t < numThreads; t++) {
+            for (Candidate& child : scratches[t].children) {
+                solution.numStates++;
+                std::size_t k = beam.key(child);
+                auto range = seen.equal_range(k);
+                auto it = std::find_if(range.first, range.second, [&](const std::pair<const std::size_t, int>& entry) {
+                    return beam.equal(children[entry.second], child);
+                });
+                if (it == range.second) {
+                    seen.emplace(k, children.size());
+                    children.emplace_back(std::move(child));
+                } else if (child.damage > children[it->second].damage) {
+                    children[it->second] = std::move(child);
+                }
+            }
+        }
+
+        // set aside the finished rotations, then keep the best of the
+        //   others by score, ties going to the earliest found
+        steps.emplace_back();
+        order.clear();
+        for (std::size_t i = 0; i < children.size(); i++) {
+            if (children[i].elapsed < options.fightLength) {
+                order.emplace_back(i);
+            } else if (bestStep < 0 || children[i].damage > solution.damage) {
+                bestStep = steps.size() - 1;
+                bestDecision = {children[i].parent, children[i].skill};
+                solution.damage = children[i].damage;
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {return children[a].score > children[b].score;});
+        if (static_cast<int>(order.size()) > options.width) {
+            solution.numPruned += order.size() - options.width;
+            order.resize(options.width);
+        }
+
+        current.clear();
+        for (int i : order) {
+            steps.back().emplace_back(children[i].parent, children[i].skill);
+            current.emplace_back(std::move(children[i]));
+        }
+    }
+
+    // steps[0] holds the decisions reaching the first beam, from the
+    //   only partial rotation of the initial one
+    std::pair<int, int> decision = bestDecision;
+    for (int step = bestStep; step >= 0; step--) {
+        solution.skills.emplace_back(decision.second);
+        if (step > 0) decision = steps[step - 1][decision.first];
+    }
+    std::reverse(solution.skills.begin(), solution.skills.end());
+    for (int index : solution.skills) {
+        if (index >= 0) solution.rotation += state.toString(index) + " ";
+    }
+    solution.dps = options.fightLength > 0 ? solution.damage / options.fightLength : 0;
+}
@@ -0,0 +1,47 @@
+#ifndef _BEAM_H_
+#define _BEAM_H_
+
+#include <cstdint>
+
+#include "state.h"
+#include "solver.h"
+
+struct BeamOptions {
+
+    // The time at which the fight ends, as in SearchOptions. Must be
+    //   positive.
+    int fightLength = 0;
+
+    // The number of partial rotations kept after every decision
+    int width = 64;
+
+    // The number of threads expanding the partial rotations at once
+    int numThreads = 1;
+
+    // The seed of the damage rolls, as in SearchOptions. Rolls are only
+    //   drawn if some skill does not declare its damage distribution;
+    //   otherwise expected damages are used.
+    std::uint64_t seed = 0;
+};
+
+// A quick, approximate alternative to the search (see node.h), over
+//   the same decisions. At every step, every kept partial rotation is
+//   extended by each available skill and by waiting, and only the
+//   width best are kept, by the damage they dealt per unit of time.
+//   Partial rotations reaching identical states at the same time are
+//   merged, and those reaching the end of the fight leave the beam.
+//   The best rotation found is not always optimal, but it gets closer
+//   as the width grows, and it can seed the priors of the search (see
+//   Node::seedPriors). Memory is
+//   proportional to the width times the number of steps, however long
+//   the search runs.
+struct BeamSearch {
+
+    // Find a rotation from the given state over the fight length, and
+    //   fill the solution with it as Solver::solve does, with numStates
+    //   the number of partial rotations scored and numPruned the number
+    //   dropped from the beam
+    static void search(const State& state, const BeamOptions& options, Solution& solution);
+};
+
+#endif
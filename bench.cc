@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+
+#include "state.h"
+#include "node.h"
+#include "rollout.h"
+#include "bm.h"
+#include "synthetic.h"
+#include "table_kit.h"
+
+// Benchmarks of the search on the BM kit, built from Skill objects and
+//   compiled into a StaticState, and on synthetic kits of 10, 30 and
+//   60 skills, with both kinds of state storage. The synthetic kits are
+//   also run from their kit files (see Synthetic::describe) by both
+//   state models of TableKit, as syntheticN-table and syntheticN-clock.
+//   Every run prints one JSON object per line each time the number of
+//   playouts reaches 1, 2 or 5 thousand times a power of ten, and at
+//   the end, so that the DPS of the best rotation can be followed as
+//   the search converges. Runs on a single thread are reproducible for
+//   a given seed. Built with make PROFILE=1, every object also holds
+//   the time per playout spent in each phase (see profile.h).
+//
+// Usage: bench [--playouts=N] [--seed=S] [--threads=T] [--cpuct=C] [--kit=NAME]
+//              [--expected-damage] [--rollouts=R] [--rollout-policy=greedy|random]
+//              [--fight-length=T] [--kit-file=PATH] [--widening=F]
+//              [--widening-exponent=E] [--prune-waiting]
+//
+// A kit file (see table_kit.h) given with --kit-file is benchmarked
+//   too, under the name of the file, and on a clock under that name
+//   followed by -clock.
+
+namespace {
+
+    struct Kit {
+        std::string name;
+        int numSkills;
+        std::function<std::unique_ptr<State>(unsigned)> makeState;
+    };
+
+    struct Config {
+        long numPlayouts = 100000;
+        unsigned seed = 1;
+        int numThreads = 1;
+        double cPUCT = 1;
+        std::string kit = "";
+        std::string kitFile = "";
+        bool expectedDamage = false;
+        int rollouts = 0;
+        std::string rolloutPolicy = "greedy";
+        int fightLength = 0;
+        double wideningFactor = 0;
+        double wideningExponent = 0.5;
+        bool pruneWaiting = false;
+    };
+
+    // Run the given number of playouts on the tree, split across the
+    //   threads, and return the time taken in seconds
+    double run(Node& root, const Config& config, long numPlayouts) {
+        std::atomic<long> claimed{0};
+        auto work = [&](int thread) {
+            while (claimed.fetch_add(1, std::memory_order_relaxed) < numPlayouts) root.playout(config.cPUCT, thread);
+        };
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 1; t < config.numThreads; t++) workers.emplace_back(work, t);
+        while (claimed.fetch_add(1, std::memory_order_relaxed) < numPlayouts) root.playout(config.cPUCT, 0);
+        for (auto it = workers.begin(); it != workers.end(); ++it) it->join();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void benchmark(const Kit& kit, bool flatStates, const Config& config) {
+        SearchOptions options;
+        options.numThreads = config.numThreads;
+        options.flatStates = flatStates;
+        options.seed = config.seed;
+        options.expectedDamage = config.expectedDamage;
+        options.rollouts = config.rollouts;
+        options.fightLength = config.fightLength;
+        options.wideningFactor = config.wideningFactor;
+        options.wideningExponent = config.wideningExponent;
+        options.pruneWaiting = config.pruneWaiting;
+        if (config.rolloutPolicy == "random") options.rolloutPolicy = std::make_shared<RandomRollout>();
+        Node root;
+        root.setState(kit.makeState(config.seed));
+        root.setOptions(options);
+
+        long done = 0;
+        double seconds = 0;
+        for (long scale = 1000; done < config.numPlayouts; scale *= 10) {
+            for (long multiple : {1, 2, 5}) {
+                long next = std::min(config.numPlayouts, multiple * scale);
+                if (next <= done) continue;
+                seconds += run(root, config, next - done);
+                done = next;
+
+                std::pair<std::string, double> best = root.currentBestPath();
+                std::printf("{\"kit\": \"%s\", \"skills\": %d, \"states\": \"%s\", \"damage\": \"%s\", \"rollouts\": %d, "
+                            "\"fight_length\": %d, \"seed\": %u, \"threads\": %d, \"playouts\": %ld, \"seconds\": %.6f, "
+                            "\"playouts_per_sec\": %.1f, \"ns_per_playout\": %.1f, \"nodes\": %ld, \"bytes_per_node\": %.1f, "
+                            "\"dps\": %.6f%s}\n",
+                            kit.name.c_str(), kit.numSkills, flatStates ? "flat" : "objects",
+                            config.expectedDamage ? "expected" : "sampled", config.rollouts, config.fightLength,
+                            config.seed, config.numThreads, done, seconds, done / seconds, seconds * 1e9 / done,
+                            root.size(), static_cast<double>(root.bytesUsed()) / root.size(), best.second,
+                            Profile::enabled ? (", \"profile\": " + Profile::toJson(root.profile())).c_str() : "");
+                std::fflush(stdout);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+        if (arg.rfind("--playouts=", 0) == 0) config.numPlayouts = std::stol(arg.substr(11));
+        else if (arg.rfind("--seed=", 0) == 0) config.seed = std::stoul(arg.substr(7));
+        else if (arg.rfind("--threads=", 0) == 0) config.numThreads = std::stoi(arg.substr(10));
+        else if (arg.rfind("--cpuct=", 0) == 0) config.cPUCT = std::stod(arg.substr(8));
+        else if (arg.rfind("--kit=", 0) == 0) config.kit = arg.substr(6);
+        else if (arg.rfind("--kit-file=", 0) == 0) config.kitFile = arg.substr(11);
+        else if (arg == "--expected-damage") config.expectedDamage = true;
+        else if (arg.rfind("--rollouts=", 0) == 0) config.rollouts = std::stoi(arg.substr(11));
+        else if (arg.rfind("--rollout-policy=", 0) == 0) config.rolloutPolicy = arg.substr(17);
+        else if (arg.rfind("--fight-length=", 0) == 0) config.fightLength = std::stoi(arg.substr(15));
+        else if (arg.rfind("--widening=", 0) == 0) config.wideningFactor = std::stod(arg.substr(11));
+        else if (arg.rfind("--widening-exponent=", 0) == 0) config.wideningExponent = std::stod(arg.substr(20));
+        else if (arg == "--prune-waiting") config.pruneWaiting = true;
+        else {
+            std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<Kit> kits;
+    kits.push_back(Kit{"bm", 3, [](unsigned) {return BM::makeState();}});
+    kits.push_back(Kit{"bm-static", 3, [](unsigned) {return BM::makeStaticState();}});
+    for (int numSkills : {10, 30, 60}) {
+        kits.push_back(Kit{"synthetic" + std::to_string(numSkills), numSkills,
+                           [numSkills](unsigned seed) {return Synthetic::makeState(numSkills, seed);}});
+    }
+    for (bool clock : {false, true}) {
+        for (int numSkills : {10, 30, 60}) {
+            kits.push_back(Kit{"synthetic" + std::to_string(numSkills) + (clock ? "-clock" : "-table"), numSkills,
+                               [numSkills, clock](unsigned seed) {
+                                   std::string error;
+                                   std::istringstream kit{Synthetic::describe(numSkills, seed)};
+                                   return TableKit::parse(kit, error, clock);
+                               }});
+        }
+    }
+
+    for (bool clock : {false, true}) {
+        if (config.kitFile.empty()) break;
+        std::string error;
+        std::shared_ptr<State> state = TableKit::load(config.kitFile, error, clock);
+        if (!state) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        std::string name = config.kitFile.substr(config.kitFile.find_last_of('/') + 1) + (clock ? "-clock" : "");
+        kits.push_back(Kit{name, state->getNumSkills(), [state](unsigned) {return std::unique_ptr<State>{state->copy()};}});
+    }
+
+    for (const Kit& kit : kits) {
+        if (!config.kit.empty() && kit.name != config.kit) continue;
+        benchmark(kit, false, config);
+        benchmark(kit, true, config);
+    }
+}
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "rng.h"
+#include "skill.h"
+#include "resources.h"
+#include "state.h"
+#include "static_state.h"
+#include "bm.h"
+
+namespace {
+
+    // Return a number from 1 to 5 uniformly at random
+    int roll(Rng& rng) {return rng.uniform(1, 5);}
+
+    // Set the outcomes to those of a cast dealing the crit damage if
+    //   roll() is at least the given number, otherwise the damage
+    bool critOutcomes(std::vector<DamageOutcome>& outcomes, int critRoll, int damage, int critDamage) {
+        double critChance = (6 - critRoll) / 5.0;
+        outcomes.assign({DamageOutcome{damage, 1 - critChance}, DamageOutcome{critDamage, critChance}});
+        return true;
+    }
+
+    // The expected damage of the outcomes above
+    double expectedDamage(int critRoll, int damage, int critDamage) {
+        double critChance = (6 - critRoll) / 5.0;
+        return damage * (1 - critChance) + critDamage * critChance;
+    }
+}
+
+// Example (a simplified BM rotation): 3 skills called Lunar Slash, 
+//   Dragon Tongue, and Flicker, with their effects as follows:
+//   - Lunar Slash: Has 400 millisecond cast time, does 100 damage
+//     non-crit and 180 damage crit, with 40% chance of critting.
+//     Has 18 sec cooldown measured from the end of its cast. Triggers
+//     conflagration for 3 secs measured from the end of its cast.
+//   - Dragon Tongue: Has 400 millisecond cast time, does 120 damage
+//     non-crit and 200 damage crit when conflagration is down, with
+//     40% chance of critting, and does 180 damage non-crit and 320
+//     damage crit when conflagration is up, with 60% chance of critting.
+//     Has 6 sec cooldown measured from the end of its cast only if
+//     conflagration is down. Reduces the cooldown of Lunar Slash by
+//     1 sec on every cast.
+//   - Flicker: has 250 millisecond cast time, does 40 damage non-crit
+//     and 60 damage crit, with 40% chance of critting. Has no cooldown.
+//     Reduces the cooldown of Dragon Tongue by 2 secs on every cast.
+//   In addition, there is a resource called Focus, starting at 10
+//   units. One unit is regenerated every second when it is not at
+//   its maximum. Every cast of Lunar Slash triggers regeneration of
+//   3 units of Focus immediately after cast, in addition to 3 units
+//   every second for 6 seconds. Every Dragon Tongue costs 2 units
+//   when conflagration is down and 1 unit when conflagration is up.
+//   Every Flicker costs 1 unit.
+
+class LunarSlash;
+class DragonTongue;
+class Flicker;
+
+// The indices of the skills in the State
+enum {LunarSlashId, DragonTongueId, FlickerId};
+
+// The resources of the kit as plain data, shared by the Resources
+//   object and the compiled kit
+struct Focus {
+    int focus = 10;
+    int focusRegenOffset = 0;
+    int conflagration = false;
+    int conflagrationTimeLeft = 0;
+    int timeSinceLastLS = 6000;
+
+    int timeUntilNextUpdate() const {
+        // return the minimum of the conflagration time left, the
+        //   natural focus regen time left, and the lunar slash
+        //   focus regen time left
+        int conflagrationLeft = conflagrationTimeLeft > 0 ? conflagrationTimeLeft : 3600000;
+        int naturalRegenTimeLeft = focus == 10 ? 3600000 : 1000 - focusRegenOffset;
+        int lsRegenTimeLeft = timeSinceLastLS < 6000 ? 1000 - (timeSinceLastLS % 1000) : 3600000;
+        return conflagrationLeft < naturalRegenTimeLeft ?
+            (conflagrationLeft < lsRegenTimeLeft ? conflagrationLeft : lsRegenTimeLeft) :
+            (naturalRegenTimeLeft < lsRegenTimeLeft ? naturalRegenTimeLeft : lsRegenTimeLeft);
+    }
+
+    void wait(int time) {
+
+        // conflagration
+        if (conflagration) {
+            conflagrationTimeLeft -= time;
+            if (conflagrationTimeLeft <= 0) {
+                conflagrationTimeLeft = 0;
+                conflagration = false;
+            }
+        }
+
+        // natural regen of focus
+        if (focus < 10) {
+            focusRegenOffset += time;
+            if (focusRegenOffset >= 1000) {
+                focus += 1;
+                focusRegenOffset -= 1000;
+                if (focus == 10) {
+                    focusRegenOffset = 0;
+                }
+            }
+        }
+
+        // focus regen from lunar slash; any time of at least 6 seconds
+        //   since the last lunar slash behaves the same, so such times
+        //   are all stored as 6 seconds
+        int prevTime = timeSinceLastLS;
+        timeSinceLastLS += time;
+        if (timeSinceLastLS <= 6000) {
+            if (prevTime < 0 || (prevTime / 1000 != timeSinceLastLS / 1000)) {
+                focus += 3;
+                if (focus >= 10) {
+                    focus = 10;
+                    focusRegenOffset = 0;
+                }
+            }
+        } else {
+            timeSinceLastLS = 6000;
+        }
+    }
+
+    void castLunarSlash(int castTime) {
+        conflagration = true;
+        conflagrationTimeLeft = 3000;
+        timeSinceLastLS = -1 * castTime;
+    }
+    void castDragonTongue() {focus -= (conflagration ? 1 : 2);}
+    void castFlicker() {focus -= 1;}
+};
+
+struct BMResources : public Resources {
+
+    int getFocus() const {return f.focus;}
+    bool conflagrationUp() const {return f.conflagration;}
+
+    int timeUntilNextUpdate() const override {return f.timeUntilNextUpdate();}
+    void wait(int time) override {f.wait(time);}
+
+    Resources* copy() const override {
+        BMResources* newResources = new BMResources();
+        newResources->f = f;
+        return newResources;
+    }
+
+    std::size_t hash() const override {
+        std::size_t h = f.focus;
+        h = h * 31 + f.focusRegenOffset;
+        h = h * 31 + f.conflagrationTimeLeft;
+        h = h * 31 + f.timeSinceLastLS;
+        return h;
+    }
+    bool equals(const Resources* other) const override {
+        const Focus& g = static_cast<const BMResources*>(other)->f;
+        return f.focus == g.focus && f.focusRegenOffset == g.focusRegenOffset &&
+            f.conflagration == g.conflagration && f.conflagrationTimeLeft == g.conflagrationTimeLeft &&
+            f.timeSinceLastLS == g.timeSinceLastLS;
+    }
+    void* getBlock(std::size_t& size) override {size = sizeof(f); return &f;}
+
+    void notify(LunarSlash* ls);
+    void notify(DragonTongue* dt) {f.castDragonTongue();}
+    void notify(Flicker* fl) {f.castFlicker();}
+
+    private:
+        Focus f;
+
+};
+
+class LunarSlash : public Skill {
+    int cd = 0;
+
+    void notify(int from) override;
+    void notifyResources() override {static_cast<BMResources*>(resources)->notify(this);}
+    void useSkill() override {cd = 18000;}
+    Skill* copy() const override {LunarSlash* ls = new LunarSlash{}; ls->cd = cd; return ls;}
+
+public:
+    bool isReady() const override {return cd == 0;}
+    int timeUntilReady() const override {return cd;}
+    void wait(int time) override {cd = cd < time ? 0 : cd - time;}
+    int getDamage(Rng& rng) const override {return (roll(rng) >= 4) ? 180 : 100;}
+    bool getDamageDistribution(std::vector<DamageOutcome>& outcomes) const override {return critOutcomes(outcomes, 4, 100, 180);}
+    int getCastTime() const override {return 400;}
+    std::string toString() const override {return "L";}
+    std::size_t hash() const override {return cd;}
+    bool equals(const Skill* other) const override {return cd == static_cast<const LunarSlash*>(other)->cd;}
+    void* getBlock(std::size_t& size) override {size = sizeof(cd); return &cd;}
+};
+
+class DragonTongue : public Skill {
+    int cd = 0;
+
+    void notify(int from) override;
+    void notifyResources() override {static_cast<BMResources*>(resources)->notify(this);}
+    void useSkill() override {if (!static_cast<BMResources*>(resources)->conflagrationUp()) cd = 6000;}
+    Skill* copy() const override {DragonTongue* dt = new DragonTongue{}; dt->cd = cd; return dt;}
+
+public:
+    bool isReady() const override {
+        if (static_cast<BMResources*>(resources)->conflagrationUp()) return static_cast<BMResources*>(resources)->getFocus() >= 1;
+        else return cd == 0 && static_cast<BMResources*>(resources)->getFocus() >= 2;
+    }
+    int timeUntilReady() const override {
+        BMResources* r = static_cast<BMResources*>(resources);
+        if (r->conflagrationUp()) return r->getFocus() >= 1 ? 0 : 3600000;
+        else return r->getFocus() >= 2 ? cd : 3600000;
+    }
+    void wait(int time) override {cd = cd < time ? 0 : cd - time;}
+    int getDamage(Rng& rng) const override {
+        if (static_cast<BMResources*>(resources)->conflagrationUp()) return (roll(rng) >= 3) ? 320 : 180;
+        else return (roll(rng) >= 4) ? 200 : 120;
+    }
+    bool getDamageDistribution(std::vector<DamageOutcome>& outcomes) const override {
+        if (static_cast<BMResources*>(resources)->conflagrationUp()) return critOutcomes(outcomes, 3, 180, 320);
+        else return critOutcomes(outcomes, 4, 120, 200);
+    }
+    bool getDamageBound(double& damage, double& rate) const override {
+        damage = std::max(expectedDamage(4, 120, 200), expectedDamage(3, 180, 320));
+        rate = damage / 400;
+        return true;
+    }
+    int getCastTime() const override {return 400;}
+    std::string toString() const override {return "D";}
+    std::size_t hash() const override {return cd;}
+    bool equals(const Skill* other) const override {return cd == static_cast<const DragonTongue*>(other)->cd;}
+    void* getBlock(std::size_t& size) override {size = sizeof(cd); return &cd;}
+};
+
+class Flicker : public Skill {
+    void notify(int from) override {}
+    void notifyResources() override {static_cast<BMResources*>(resources)->notify(this);}
+    void useSkill() override {}
+    Skill* copy() const override {return new Flicker{};}
+
+public:
+    bool isReady() const override {return static_cast<BMResources*>(resources)->getFocus() >= 1;}
+    int timeUntilReady() const override {return static_cast<BMResources*>(resources)->getFocus() >= 1 ? 0 : 3600000;}
+    void wait(int time) override {}
+    int getDamage(Rng& rng) const override {return (roll(rng) >= 4) ? 60 : 40;}
+    bool getDamageDistribution(std::vector<DamageOutcome>& outcomes) const override {return critOutcomes(outcomes, 4, 40, 60);}
+    int getCastTime() const override {return 250;}
+    std::string toString() const override {return "F";}
+    std::size_t hash() const override {return 0;}
+    bool equals(const Skill* other) const override {return true;}
+    void* getBlock(std::size_t& size) override {size = 0; return this;}
+};
+
+void BMResources::notify(LunarSlash* ls) {f.castLunarSlash(ls->getCastTime());}
+
+void LunarSlash::notify(int from) {if (from == DragonTongueId) cd = cd < 1000 ? 0 : cd - 1000;}
+
+void DragonTongue::notify(int from) {
+    if (from == FlickerId) cd = cd < 2000 ? 0 : cd - 2000;
+    else if (from == LunarSlashId) cd = 0;
+}
+
+// The same kit compiled into a StaticState, which must behave exactly
+//   like the skills above
+namespace StaticBM {
+
+    struct DragonTongue;
+    struct Flicker;
+
+    struct LunarSlash {
+        static constexpr const char* name = "L";
+        int cd = 0;
+
+        bool isReady(const Focus&) const {return cd == 0;}
+        int timeUntilReady(const Focus&) const {return cd;}
+        void wait(int time) {cd = cd < time ? 0 : cd - time;}
+        void use(Focus& r) {cd = 18000; r.castLunarSlash(getCastTime(r));}
+        void notify(const DragonTongue&) {cd = cd < 1000 ? 0 : cd - 1000;}
+        int getDamage(const Focus&, Rng& rng) const {return (roll(rng) >= 4) ? 180 : 100;}
+        bool getDamageDistribution(const Focus&, std::vector<DamageOutcome>& outcomes) const {
+            return critOutcomes(outcomes, 4, 100, 180);
+        }
+        int getCastTime(const Focus&) const {return 400;}
+    };
+
+    struct DragonTongue {
+        static constexpr const char* name = "D";
+        int cd = 0;
+
+        bool isReady(const Focus& r) const {return r.conflagration ? r.focus >= 1 : cd == 0 && r.focus >= 2;}
+        int timeUntilReady(const Focus& r) const {
+            if (r.conflagration) return r.focus >= 1 ? 0 : 3600000;
+            else return r.focus >= 2 ? cd : 3600000;
+        }
+        void wait(int time) {cd = cd < time ? 0 : cd - time;}
+        void use(Focus& r) {if (!r.conflagration) cd = 6000; r.castDragonTongue();}
+        void notify(const LunarSlash&) {cd = 0;}
+        void notify(const Flicker&) {cd = cd < 2000 ? 0 : cd - 2000;}
+        int getDamage(const Focus& r, Rng& rng) const {
+            if (r.conflagration) return (roll(rng) >= 3) ? 320 : 180;
+            else return (roll(rng) >= 4) ? 200 : 120;
+        }
+        bool getDamageDistribution(const Focus& r, std::vector<DamageOutcome>& outcomes) const {
+            if (r.conflagration) return critOutcomes(outcomes, 3, 180, 320);
+            else return critOutcomes(outcomes, 4, 120, 200);
+        }
+        bool getDamageBound(double& damage, double& rate) const {
+            damage = std::max(expectedDamage(4, 120, 200), expectedDamage(3, 180, 320));
+            rate = damage / 400;
+            return true;
+        }
+        int getCastTime(const Focus&) const {return 400;}
+    };
+
+    struct Flicker {
+        static constexpr const char* name = "F";
+
+        bool isReady(const Focus& r) const {return r.focus >= 1;}
+        int timeUntilReady(const Focus& r) const {return r.focus >= 1 ? 0 : 3600000;}
+        void wait(int) {}
+        void use(Focus& r) {r.castFlicker();}
+        int getDamage(const Focus&, Rng& rng) const {return (roll(rng) >= 4) ? 60 : 40;}
+        bool getDamageDistribution(const Focus&, std::vector<DamageOutcome>& outcomes) const {
+            return critOutcomes(outcomes, 4, 40, 60);
+        }
+        int getCastTime(const Focus&) const {return 250;}
+    };
+}
+
+std::unique_ptr<State> BM::makeState() {
+    std::vector<std::unique_ptr<Skill>> skills;
+    std::unique_ptr<Resources> resources = std::make_unique<BMResources>();
+    skills.emplace_back(std::make_unique<LunarSlash>());
+    skills.emplace_back(std::make_unique<DragonTongue>());
+    skills.emplace_back(std::make_unique<Flicker>());
+    skills[0]->setResources(resources.get());
+    skills[1]->setResources(resources.get());
+    skills[2]->setResources(resources.get());
+    std::unique_ptr<State> state = std::make_unique<State>();
+    state->setSkills(std::move(skills));
+    state->setResources(std::move(resources));
+    state->setObservers({{DragonTongueId}, {LunarSlashId}, {DragonTongueId}});
+    return state;
+}
+
+std::unique_ptr<State> BM::makeStaticState() {
+    std::unique_ptr<State> state = std::make_unique<State>();
+    state->setModel(std::make_unique<StaticState<Focus, StaticBM::LunarSlash, StaticBM::DragonTongue, StaticBM::Flicker>>());
+    return state;
+}
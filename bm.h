@@ -0,0 +1,21 @@
+#ifndef _BM_H_
+#define _BM_H_
+
+#include <memory>
+
+#include "state.h"
+
+// The BM example kit (see bm.cc for its skills and resources)
+struct BM {
+
+    // Return the initial state of the kit: every skill off cooldown
+    //   and full focus.
+    static std::unique_ptr<State> makeState();
+
+    // Return the same initial state, with the kit compiled into a
+    //   StaticState (see static_state.h) instead of built from Skill
+    //   objects. Both behave identically.
+    static std::unique_ptr<State> makeStaticState();
+};
+
+#endif
@@ -1,45 +1,223 @@
 #include <iostream>
 #include <string>
-#include <curses.h>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <csignal>
 
 #include "node.h"
 #include "memcheck.h"
+#include "reporter.h"
 #include "explore.h"
 
-void Explore::explore(Node* root, double cPUCT, long numPlayouts) {
-
-    initscr();
-    noecho();
-
-    move(0, 0); printw("---------------------------------------------------");
-    move(1, 0); printw(("Total Virtual Memory: " + std::to_string(MemCheck::getTotalVirtualMem())).c_str());
-    move(2, 0); printw(("Total Physical Memory: " + std::to_string(MemCheck::getTotalPhysicalMem())).c_str());
-    move(3, 0); printw("---------------------------------------------------");
-    move(4, 0); printw(("Virtual Memory In Use By Process: " + std::to_string(MemCheck::getProcessVirtualMem())).c_str());
-    move(5, 0); printw(("Physical Memory In Use By Process: " + std::to_string(MemCheck::getProcessPhysicalMem())).c_str());
-    move(6, 0); printw("---------------------------------------------------");    
-    move(7, 0); printw("Iteration: 0");
-    move(8, 0); printw("Theoretical DPS: ");
-    move(9, 0); printw("Best Rotation: ");
-    refresh();
-
-    for (int i = 1; i <= numPlayouts; i++) {
-        root->playout(cPUCT);
-        if (i % 10000 == 0) {
-            std::pair<std::string, double> pathAndDamage = root->currentBestPath();
-            move(0, 0); printw("---------------------------------------------------");
-            move(1, 0); printw(("Total Virtual Memory: " + std::to_string(MemCheck::getTotalVirtualMem())).c_str());
-            move(2, 0); printw(("Total Physical Memory: " + std::to_string(MemCheck::getTotalPhysicalMem())).c_str());
-            move(3, 0); printw("---------------------------------------------------");
-            move(4, 0); printw(("Virtual Memory In Use By Process: " + std::to_string(MemCheck::getProcessVirtualMem())).c_str());
-            move(5, 0); printw(("Physical Memory In Use By Process: " + std::to_string(MemCheck::getProcessPhysicalMem())).c_str());
-            move(6, 0); printw("---------------------------------------------------");
-            move(7, 0); printw(("Iteration: " + std::to_string(i)).c_str());
-            move(8, 0); printw(("Theoretical DPS: " + std::to_string(pathAndDamage.second)).c_str());
-            move(9, 0); printw(("Best Rotation: " + pathAndDamage.first).c_str());
-            refresh();
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    Explore::Output output = Explore::Output::Curses;
+    double reportInterval = 0.5;
+
+    std::string checkpointPath = "";
+    double checkpointInterval = 0;
+    volatile std::sig_atomic_t terminated = 0;
+
+    void onTerminate(int) {terminated = 1;}
+
+    // Saves a checkpoint if one is set and due
+    void checkpoint(Node* root, Clock::time_point& last, bool force) {
+        if (checkpointPath.empty()) return;
+        auto now = Clock::now();
+        if (!force && std::chrono::duration<double>(now - last).count() < checkpointInterval) return;
+        root->saveCheckpoint(checkpointPath);
+        last = now;
+    }
+
+    std::unique_ptr<Reporter> makeReporter() {
+        switch (output) {
+            case Explore::Output::Json: return std::make_unique<JsonReporter>(std::cout);
+            case Explore::Output::Csv: return std::make_unique<CsvReporter>(std::cout);
+            default: return std::make_unique<CursesReporter>();
         }
     }
 
-    endwin();
+    Progress makeProgress(long iteration, int numThreads, Clock::time_point start, long numNodes, long numReclaimed,
+                          std::size_t bytesUsed, const std::pair<std::string, double>& pathAndDamage,
+                          const Profile::Counters& profile) {
+        Progress progress;
+        progress.iteration = iteration;
+        progress.numThreads = numThreads;
+        progress.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        progress.numNodes = numNodes;
+        progress.numReclaimed = numReclaimed;
+        progress.bytesUsed = bytesUsed;
+        progress.processVirtualMem = MemCheck::getProcessVirtualMem();
+        progress.processPhysicalMem = MemCheck::getProcessPhysicalMem();
+        progress.rotation = pathAndDamage.first;
+        progress.dps = pathAndDamage.second;
+        progress.profile = profile;
+        return progress;
+    }
+
+    // Calls the given function every reportInterval seconds on a
+    //   thread of its own, and once more when stopped
+    class Ticker final {
+        private:
+            std::function<void()> tick;
+            std::mutex mutex;
+            std::condition_variable wake;
+            bool stopped = false;
+            std::thread thread;
+
+        public:
+            explicit Ticker(std::function<void()> tick): tick{std::move(tick)} {
+                thread = std::thread{[this]() {
+                    std::unique_lock<std::mutex> lock{mutex};
+                    auto interval = std::chrono::duration<double>(reportInterval);
+                    while (!wake.wait_for(lock, interval, [this]() {return stopped;})) this->tick();
+                }};
+            }
+
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    stopped = true;
+                }
+                wake.notify_all();
+                thread.join();
+                tick();
+            }
+    };
+
+    // Runs the given number of playouts on the tree, claimed from a
+    //   shared counter by the calling thread and numThreads - 1 more,
+    //   counting them in completed. Stops early on SIGTERM.
+    void runPlayouts(Node* root, double cPUCT, long numPlayouts, int numThreads, std::atomic<long>& completed) {
+        std::atomic<long> claimed{0};
+        auto work = [&](int thread) {
+            while (!terminated && claimed.fetch_add(1, std::memory_order_relaxed) < numPlayouts) {
+                root->playout(cPUCT, thread);
+                completed.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int t = 1; t < numThreads; t++) workers.emplace_back(work, t);
+        work(0);
+        for (auto it = workers.begin(); it != workers.end(); ++it) it->join();
+    }
+}
+
+void Explore::setOutput(Output newOutput, double intervalSeconds) {
+    output = newOutput;
+    reportInterval = intervalSeconds;
+}
+
+void Explore::setCheckpoint(const std::string& path, double intervalSeconds) {
+    checkpointPath = path;
+    checkpointInterval = intervalSeconds;
+    if (!path.empty()) std::signal(SIGTERM, onTerminate);
+}
+
+void Explore::explore(Node* root, double cPUCT, long numPlayouts, int numThreads) {
+    std::unique_ptr<Reporter> reporter = makeReporter();
+    std::atomic<long> completed{0};
+    auto start = Clock::now();
+    auto lastCheckpoint = start;
+
+    // every thread searches; the reporter snapshots the tree while
+    //   they do
+    Ticker ticker{[&]() {
+        long iteration = completed.load(std::memory_order_relaxed);
+        reporter->report(makeProgress(iteration, numThreads, start, root->size(), root->numReclaimed(),
+                                      root->bytesUsed(), root->currentBestPath(), root->profile()));
+        checkpoint(root, lastCheckpoint, false);
+    }};
+    runPlayouts(root, cPUCT, numPlayouts, numThreads, completed);
+    ticker.stop();
+    checkpoint(root, lastCheckpoint, true);
+}
+
+void Explore::exploreEnsemble(const std::vector<Node*>& roots, double cPUCT, long numPlayouts) {
+    std::unique_ptr<Reporter> reporter = makeReporter();
+    int numTrees = roots.size();
+    std::atomic<long> completed{0};
+    auto start = Clock::now();
+
+    Ticker ticker{[&]() {
+        long numNodes = 0, numReclaimed = 0;
+        std::size_t bytesUsed = 0;
+        Profile::Counters profile;
+        for (Node* root : roots) {
+            numNodes += root->size();
+            numReclaimed += root->numReclaimed();
+            bytesUsed += root->bytesUsed();
+            profile += root->profile();
+        }
+        long iteration = completed.load(std::memory_order_relaxed);
+        reporter->report(makeProgress(iteration, numTrees, start, numNodes, numReclaimed, bytesUsed,
+                                      Node::currentBestPath(roots), profile));
+    }};
+
+    // Every tree gets its own thread and an equal share of the
+    //   playouts, this thread searching the first tree
+    auto work = [&](int t) {
+        long share = numPlayouts / numTrees + (t < numPlayouts % numTrees ? 1 : 0);
+        for (long j = 0; j < share && !terminated; j++) {
+            roots[t]->playout(cPUCT);
+            completed.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < numTrees; t++) workers.emplace_back(work, t);
+    work(0);
+    for (auto it = workers.begin(); it != workers.end(); ++it) it->join();
+
+    ticker.stop();
+}
+
+void Explore::exploreReceding(Node* root, double cPUCT, long playoutsPerStep, int fightLength, int numThreads) {
+    std::unique_ptr<Reporter> reporter = makeReporter();
+    std::atomic<long> completed{0};
+    auto start = Clock::now();
+    auto lastCheckpoint = start;
+
+    // committing an edge frees part of the tree, so the reporter must
+    //   not look at it meanwhile
+    std::mutex commitMutex;
+    std::string rotation = "";
+    double damage = 0;
+
+    Ticker ticker{[&]() {
+        std::lock_guard<std::mutex> lock{commitMutex};
+        std::pair<std::string, double> best = root->currentBestPath();
+        double dps = root->elapsed() > 0 ? damage / root->elapsed() : 0;
+        long iteration = completed.load(std::memory_order_relaxed);
+        reporter->report(makeProgress(iteration, numThreads, start, root->size(), root->numReclaimed(),
+                                      root->bytesUsed(), {rotation + "| " + best.first, dps}, root->profile()));
+        checkpoint(root, lastCheckpoint, false);
+    }};
+
+    while (!terminated && root->elapsed() < fightLength) {
+        runPlayouts(root, cPUCT, playoutsPerStep, numThreads, completed);
+        if (terminated) break;
+
+        std::lock_guard<std::mutex> lock{commitMutex};
+        std::pair<std::string, double> committed = root->commitBestEdge();
+        if (!committed.first.empty()) rotation += committed.first + " ";
+        damage += committed.second;
+    }
+    ticker.stop();
+    checkpoint(root, lastCheckpoint, true);
+    reporter.reset();
+
+    // the last report already holds the rotation in other outputs
+    if (output != Output::Curses) return;
+    double dps = root->elapsed() > 0 ? damage / root->elapsed() : 0;
+    std::cout << "Rotation: " << rotation << std::endl;
+    std::cout << "Fight Length: " << root->elapsed() << std::endl;
+    std::cout << "Theoretical DPS: " << dps << std::endl;
 }
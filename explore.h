@@ -1,16 +1,60 @@
 #ifndef _EXPLORE_H_
 #define _EXPLORE_H_
 
+#include <string>
+#include <vector>
+
 class Node;
 
 struct Explore {
 
+    // Where the progress of an exploration is reported (see
+    //   reporter.h): a curses display, or JSON lines or CSV rows on
+    //   standard output for running without a terminal
+    enum class Output {Curses, Json, Csv};
+
+    // Report the progress of every exploration to the given output
+    //   every intervalSeconds seconds, from a thread of its own so
+    //   that the search never waits for it, and once more when the
+    //   exploration ends. The default is a curses display updated
+    //   every half second.
+    static void setOutput(Output output, double intervalSeconds);
+
+    // Save a checkpoint of the tree to the given path (see
+    //   Node::saveCheckpoint) every intervalSeconds seconds during
+    //   explore() and exploreReceding(), and once more when they end.
+    //   Receiving SIGTERM ends them early, after the last checkpoint
+    //   is saved. An empty path turns checkpoints off.
+    static void setCheckpoint(const std::string& path, double intervalSeconds);
+
     // Start exploration of the given node, using the cPUCT and
-    //   the number of playouts given. The node must be fully
-    //   initialized and ready to call playout() on. Displays
-    //   statistics about the memory usage, the iteration number,
-    //   and the current optimal path in a curses display.
-    static void explore(Node* root, double cPUCT, long numPlayouts);
+    //   the number of playouts given, split across the given number
+    //   of threads. The node must be fully initialized, with its
+    //   options allowing that many threads, and ready to call
+    //   playout() on. Reports statistics about the memory usage,
+    //   the iteration number, the playout throughput, and the
+    //   current optimal path.
+    static void explore(Node* root, double cPUCT, long numPlayouts, int numThreads = 1);
+
+    // Start exploration of an ensemble of independent trees grown
+    //   from identical states, one thread per tree, sharing the
+    //   number of playouts given equally between them. The trees
+    //   are never touched by more than one thread. The reports are
+    //   the same as for explore(), with the best rotation found by
+    //   merging the statistics of every tree.
+    static void exploreEnsemble(const std::vector<Node*>& roots, double cPUCT, long numPlayouts);
+
+    // Start a receding-horizon exploration of the given node: run
+    //   the number of playouts given (split across the threads as in
+    //   explore()), commit the most visited edge of the root, and
+    //   repeat from its child until the committed edges cover the
+    //   fight length given. Only the subtree below the current root
+    //   is kept, so memory stays bounded however long the fight is.
+    //   The reports show the committed rotation followed by the
+    //   current best path below the root, and with the curses
+    //   display, the committed rotation is printed once the
+    //   exploration ends.
+    static void exploreReceding(Node* root, double cPUCT, long playoutsPerStep, int fightLength, int numThreads = 1);
 };
 
 #endif
@@ -1,231 +1,182 @@
+#include <iostream>
+#include <chrono>
 #include <string>
 #include <vector>
-#include <random>
 #include <memory>
 #include <utility>
 
 #include "skill.h"
-#include "resources.h"
+#include "state.h"
 #include "node.h"
+#include "rollout.h"
+#include "solver.h"
+#include "beam.h"
+#include "bm.h"
+#include "table_kit.h"
 #include "explore.h"
 
-// Example (a simplified BM rotation): 3 skills called Lunar Slash, 
-//   Dragon Tongue, and Flicker, with their effects as follows:
-//   - Lunar Slash: Has 400 millisecond cast time, does 100 damage
-//     non-crit and 180 damage crit, with 40% chance of critting.
-//     Has 18 sec cooldown measured from the end of its cast. Triggers
-//     conflagration for 3 secs measured from the end of its cast.
-//   - Dragon Tongue: Has 400 millisecond cast time, does 120 damage
-//     non-crit and 200 damage crit when conflagration is down, with
-//     40% chance of critting, and does 180 damage non-crit and 320
-//     damage crit when conflagration is up, with 60% chance of critting.
-//     Has 6 sec cooldown measured from the end of its cast only if
-//     conflagration is down. Reduces the cooldown of Lunar Slash by
-//     1 sec on every cast.
-//   - Flicker: has 250 millisecond cast time, does 40 damage non-crit
-//     and 60 damage crit, with 40% chance of critting. Has no cooldown.
-//     Reduces the cooldown of Dragon Tongue by 2 secs on every cast.
-//   In addition, there is a resource called Focus, starting at 10
-//   units. One unit is regenerated every second when it is not at
-//   its maximum. Every cast of Lunar Slash triggers regeneration of
-//   3 units of Focus immediately after cast, in addition to 3 units
-//   every second for 6 seconds. Every Dragon Tongue costs 2 units
-//   when conflagration is down and 1 unit when conflagration is up.
-//   Every Flicker costs 1 unit.
-
-class LunarSlash;
-class DragonTongue;
-class Flicker;
-
-struct BMResources : public Resources {
-
-    int focus = 10;
-    bool conflagrationUp() const {return conflagration;}
+int main(int argc, char* argv[]) {
 
-    int timeUntilNextUpdate() const override {
-        // return the minimum of the conflagration time left, the
-        //   natural focus regen time left, and the lunar slash
-        //   focus regen time left
-        int conflagrationLeft = conflagrationTimeLeft > 0 ? conflagrationTimeLeft : 3600000;
-        int naturalRegenTimeLeft = focus == 10 ? 3600000 : 1000 - focusRegenOffset;
-        int lsRegenTimeLeft = timeSinceLastLS < 6000 ? 1000 - (timeSinceLastLS % 1000) : 3600000;
-        return conflagrationLeft < naturalRegenTimeLeft ?
-            (conflagrationLeft < lsRegenTimeLeft ? conflagrationLeft : lsRegenTimeLeft) :
-            (naturalRegenTimeLeft < lsRegenTimeLeft ? naturalRegenTimeLeft : lsRegenTimeLeft);
+    // Arguments starting with "--" set search options; the rest are
+    //   positional: cPUCT, number of playouts, number of threads, mode
+    SearchOptions options;
+    double maxDamageRate = 0;
+    int beamWidth = 64;
+    bool seedBeam = false;
+    std::string checkpointPath = "", resumePath = "";
+    double checkpointInterval = 600;
+    Explore::Output output = Explore::Output::Curses;
+    double reportInterval = 0.5;
+    bool compiled = false;
+    std::string kitPath = "";
+    bool clock = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+        if (arg == "--transpositions") options.transpositions = true;
+        else if (arg == "--flat") options.flatStates = true;
+        else if (arg.rfind("--materialize-every=", 0) == 0) options.materializeEvery = std::stoi(arg.substr(20));
+        else if (arg.rfind("--fight-length=", 0) == 0) options.fightLength = std::stoi(arg.substr(15));
+        else if (arg.rfind("--memory-budget=", 0) == 0) options.memoryBudget = std::stoul(arg.substr(16)) << 20;
+        else if (arg == "--expected-damage") options.expectedDamage = true;
+        else if (arg.rfind("--widening=", 0) == 0) options.wideningFactor = std::stod(arg.substr(11));
+        else if (arg.rfind("--widening-exponent=", 0) == 0) options.wideningExponent = std::stod(arg.substr(20));
+        else if (arg == "--prune-waiting") options.pruneWaiting = true;
+        else if (arg == "--static") compiled = true;
+        else if (arg.rfind("--kit=", 0) == 0) kitPath = arg.substr(6);
+        else if (arg == "--clock") clock = true;
+        else if (arg.rfind("--rollouts=", 0) == 0) options.rollouts = std::stoi(arg.substr(11));
+        else if (arg.rfind("--rollout-horizon=", 0) == 0) options.rolloutHorizon = std::stoi(arg.substr(18));
+        else if (arg == "--rollout-policy=greedy") options.rolloutPolicy = std::make_shared<GreedyRollout>();
+        else if (arg == "--rollout-policy=random") options.rolloutPolicy = std::make_shared<RandomRollout>();
+        else if (arg.rfind("--beam-width=", 0) == 0) beamWidth = std::stoi(arg.substr(13));
+        else if (arg == "--seed-beam") seedBeam = true;
+        else if (arg.rfind("--max-damage-rate=", 0) == 0) maxDamageRate = std::stod(arg.substr(18));
+        else if (arg.rfind("--seed=", 0) == 0) options.seed = std::stoull(arg.substr(7));
+        else if (arg.rfind("--checkpoint=", 0) == 0) checkpointPath = arg.substr(13);
+        else if (arg.rfind("--checkpoint-interval=", 0) == 0) checkpointInterval = std::stod(arg.substr(22));
+        else if (arg.rfind("--resume=", 0) == 0) resumePath = arg.substr(9);
+        else if (arg == "--output=json") output = Explore::Output::Json;
+        else if (arg == "--output=csv") output = Explore::Output::Csv;
+        else if (arg.rfind("--report-interval=", 0) == 0) reportInterval = std::stod(arg.substr(18));
+        else args.emplace_back(arg);
     }
 
-    void wait(int time) override {
-
-        // conflagration
-        if (conflagration) {
-            conflagrationTimeLeft -= time;
-            if (conflagrationTimeLeft <= 0) {
-                conflagrationTimeLeft = 0;
-                conflagration = false;
-            }
-        }
+    double cPUCT = 1;
+    if (args.size() > 0) cPUCT = std::stod(args[0]);
 
-        // natural regen of focus
-        if (focus < 10) {
-            focusRegenOffset += time;
-            if (focusRegenOffset >= 1000) {
-                focus += 1;
-                focusRegenOffset -= 1000;
-                if (focus == 10) {
-                    focusRegenOffset = 0;
-                }
-            }
+    long numPlayouts = 10000000;
+    if (args.size() > 1) numPlayouts = std::stol(args[1]);
+
+    int numThreads = 1;
+    if (args.size() > 2) numThreads = std::stoi(args[2]);
+
+    // "tree" searches one tree with all threads, "root" searches one
+    //   independent tree per thread and merges their statistics, and
+    //   "receding" searches one tree with all threads, committing one
+    //   edge after every numPlayouts playouts until the fight length
+    //   (180 seconds unless given) is covered, "inspect" prints the
+    //   best rotation of the checkpoint given with --resume, and
+    //   "solve" finds the optimal rotation over the fight length
+    //   exactly with all threads, cutting off branches with the damage
+    //   bound of the kit, or the tighter one given by --max-damage-rate
+    //   if any (see solver.h), and "beam" finds a rotation over the
+    //   fight length quickly with a beam of the width given by
+    //   --beam-width (see beam.h). With --seed-beam, the other modes
+    //   first make the search try the rotation found by the beam.
+    std::string mode = "tree";
+    if (args.size() > 3) mode = args[3];
+
+    // the BM kit of bm.cc, unless a kit file is given (see table_kit.h),
+    //   run on a clock with --clock
+    std::unique_ptr<State> state = compiled ? BM::makeStaticState() : BM::makeState();
+    if (!kitPath.empty()) {
+        std::string error;
+        state = TableKit::load(kitPath, error, clock);
+        if (!state) {
+            std::cerr << error << std::endl;
+            return 1;
         }
-
-        // focus regen from lunar slash
-        int prevTime = timeSinceLastLS;
-        timeSinceLastLS += time;
-        if (timeSinceLastLS <= 6000) {
-            if (prevTime < 0 || (prevTime / 1000 != timeSinceLastLS / 1000)) {
-                focus += 3;
-                if (focus >= 10) {
-                    focus = 10;
-                    focusRegenOffset = 0;
-                }
-            }
+    }
+    BeamOptions beamOptions;
+    beamOptions.fightLength = options.fightLength ? options.fightLength : 180000;
+    beamOptions.width = beamWidth;
+    beamOptions.numThreads = numThreads;
+    beamOptions.seed = options.seed;
+    if (mode == "beam") {
+        Solution solution;
+        auto start = std::chrono::steady_clock::now();
+        BeamSearch::search(*state, beamOptions, solution);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "States Searched: " << solution.numStates << std::endl;
+        std::cout << "Seconds: " << seconds << std::endl;
+        std::cout << "Best Rotation: " << solution.rotation << std::endl;
+        std::cout << "Expected Damage: " << solution.damage << std::endl;
+        std::cout << "Theoretical DPS: " << solution.dps << std::endl;
+        return 0;
+    }
+    Solution seed;
+    if (seedBeam) BeamSearch::search(*state, beamOptions, seed);
+    if (mode == "solve") {
+        SolverOptions solverOptions;
+        solverOptions.fightLength = options.fightLength ? options.fightLength : 180000;
+        solverOptions.numThreads = numThreads;
+        solverOptions.maxDamageRate = maxDamageRate;
+        Solution solution;
+        auto start = std::chrono::steady_clock::now();
+        if (!Solver::solve(*state, solverOptions, solution)) {
+            std::cerr << "Every skill must declare its damage distribution" << std::endl;
+            return 1;
         }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "States Searched: " << solution.numStates << std::endl;
+        std::cout << "Branches Pruned: " << solution.numPruned << std::endl;
+        std::cout << "Seconds: " << seconds << std::endl;
+        std::cout << "Best Rotation: " << solution.rotation << std::endl;
+        std::cout << "Expected Damage: " << solution.damage << std::endl;
+        std::cout << "Theoretical DPS: " << solution.dps << std::endl;
+        return 0;
     }
-
-    Resources* copy() const override {
-        BMResources* newResources = new BMResources();
-        newResources->focus = focus;
-        newResources->focusRegenOffset = focusRegenOffset;
-        newResources->conflagration = conflagration;
-        newResources->conflagrationTimeLeft = conflagrationTimeLeft;
-        newResources->timeSinceLastLS = timeSinceLastLS;
-        return newResources;
+    Explore::setOutput(output, reportInterval);
+    if (mode == "root") {
+        // every tree rolls its damages from a seed of its own, so that
+        //   the trees are not all identical
+        std::vector<std::unique_ptr<Node>> trees;
+        std::vector<Node*> roots;
+        for (int t = 0; t < numThreads; t++) {
+            trees.emplace_back(std::make_unique<Node>());
+            trees.back()->setState(std::unique_ptr<State>(state->copy()));
+            SearchOptions treeOptions = options;
+            treeOptions.seed = options.seed + t;
+            trees.back()->setOptions(treeOptions);
+            if (seedBeam) trees.back()->seedPriors(seed.skills, 1);
+            roots.emplace_back(trees.back().get());
+        }
+        Explore::exploreEnsemble(roots, cPUCT, numPlayouts);
+        return 0;
     }
 
-    void notify(LunarSlash* ls);
-    void notify(DragonTongue* dt) {focus -= (conflagration ? 1 : 2);}
-    void notify(Flicker* fl) {focus -= 1;}
-
-    private:
-        int focusRegenOffset = 0;
-        bool conflagration = false;
-        int conflagrationTimeLeft = 0;
-        int timeSinceLastLS = 3600000;
-
-};
-
-class LunarSlash : public Skill {
-    static std::mt19937 mt;
-    static std::uniform_int_distribution<int> dist;
-
-    int cd = 0;
-
-    void notify(Skill* from) override;
-    void notifyResources() override {static_cast<BMResources*>(resources)->notify(this);}
-    void useSkill() override {cd = 18000;}
-    Skill* copy() const override {LunarSlash* ls = new LunarSlash{}; ls->cd = cd; return ls;}
-
-public:
-    bool isReady() const override {return cd == 0;}
-    int timeUntilReady() const override {return cd;}
-    void wait(int time) override {cd = cd < time ? 0 : cd - time;}
-    int getDamage() const override {return (dist(mt) >= 4) ? 180 : 100;}
-    int getCastTime() const override {return 400;}
-    std::string toString() const override {return "L";}
-};
-
-class DragonTongue : public Skill {
-    static std::mt19937 mt;
-    static std::uniform_int_distribution<int> dist;
-
-    int cd = 0;
+    Node root;
+    root.setState(std::move(state));
 
-    void notify(Skill* from) override;
-    void notifyResources() override {static_cast<BMResources*>(resources)->notify(this);}
-    void useSkill() override {if (!static_cast<BMResources*>(resources)->conflagrationUp()) cd = 6000;}
-    Skill* copy() const override {DragonTongue* dt = new DragonTongue{}; dt->cd = cd; return dt;}
+    options.numThreads = numThreads;
+    root.setOptions(options);
 
-public:
-    bool isReady() const override {
-        if (static_cast<BMResources*>(resources)->conflagrationUp()) return static_cast<BMResources*>(resources)->focus >= 1;
-        else return cd == 0 && static_cast<BMResources*>(resources)->focus >= 2;
-    }
-    int timeUntilReady() const override {
-        BMResources* r = static_cast<BMResources*>(resources);
-        if (r->conflagrationUp()) return r->focus >= 1 ? 0 : 3600000;
-        else return r->focus >= 2 ? cd : 3600000;
+    if (!resumePath.empty() && !root.loadCheckpoint(resumePath)) {
+        std::cerr << "Could not load checkpoint " << resumePath << std::endl;
+        return 1;
     }
-    void wait(int time) override {cd = cd < time ? 0 : cd - time;}
-    int getDamage() const override {
-        if (static_cast<BMResources*>(resources)->conflagrationUp()) return (dist(mt) >= 3) ? 320 : 180;
-        else return (dist(mt) >= 4) ? 200 : 120;
+    if (seedBeam && resumePath.empty()) root.seedPriors(seed.skills, 1);
+    if (mode == "inspect") {
+        std::pair<std::string, double> best = root.currentBestPath();
+        std::cout << "Tree Nodes: " << root.size() << std::endl;
+        std::cout << "Best Rotation: " << best.first << std::endl;
+        std::cout << "Theoretical DPS: " << best.second << std::endl;
+        return 0;
     }
-    int getCastTime() const override {return 400;}
-    std::string toString() const override {return "D";}
-};
-
-class Flicker : public Skill {
-    static std::mt19937 mt;
-    static std::uniform_int_distribution<int> dist;
-
-    void notify(Skill* from) override {}
-    void notifyResources() override {static_cast<BMResources*>(resources)->notify(this);}
-    void useSkill() override {}
-    Skill* copy() const override {return new Flicker{};}
-
-public:
-    bool isReady() const override {return static_cast<BMResources*>(resources)->focus >= 1;}
-    int timeUntilReady() const override {return static_cast<BMResources*>(resources)->focus >= 1 ? 0 : 3600000;}
-    void wait(int time) override {}
-    int getDamage() const override {return (dist(mt) >= 4) ? 60 : 40;}
-    int getCastTime() const override {return 250;}
-    std::string toString() const override {return "F";}
-};
-
-void BMResources::notify(LunarSlash* ls) {
-    conflagration = true;
-    conflagrationTimeLeft = 3000;
-    timeSinceLastLS = -1 * ls->getCastTime();
-}
-
-void LunarSlash::notify(Skill* from) {if (dynamic_cast<DragonTongue*>(from)) cd = cd < 1000 ? 0 : cd - 1000;}
-
-void DragonTongue::notify(Skill* from) {
-    if (dynamic_cast<Flicker*>(from)) cd = cd < 2000 ? 0 : cd - 2000;
-    else if (dynamic_cast<LunarSlash*>(from)) cd = 0;
-}
-
-std::random_device rd;
-std::mt19937 LunarSlash::mt = std::mt19937{rd()};
-std::uniform_int_distribution<int> LunarSlash::dist = std::uniform_int_distribution<int>{1, 5};
-std::mt19937 DragonTongue::mt = std::mt19937{rd()};
-std::uniform_int_distribution<int> DragonTongue::dist = std::uniform_int_distribution<int>{1, 5};
-std::mt19937 Flicker::mt = std::mt19937{rd()};
-std::uniform_int_distribution<int> Flicker::dist = std::uniform_int_distribution<int>{1, 5};
-
-int main(int argc, char* argv[]) {
-
-    double cPUCT = 1;
-    if (argc > 1) cPUCT = std::stod(std::string(argv[1]));
-
-    long numPlayouts = 10000000;
-    if (argc > 2) numPlayouts = std::stol(std::string(argv[2]));
-
-    std::vector<std::unique_ptr<Skill>> skills;
-    std::unique_ptr<Resources> resources = std::make_unique<BMResources>();
-    skills.emplace_back(std::make_unique<LunarSlash>());
-    skills.emplace_back(std::make_unique<DragonTongue>());
-    skills.emplace_back(std::make_unique<Flicker>());
-    skills[0]->addObserver(skills[1].get());
-    skills[1]->addObserver(skills[0].get());
-    skills[2]->addObserver(skills[1].get());
-    skills[0]->setResources(resources.get());
-    skills[1]->setResources(resources.get());
-    skills[2]->setResources(resources.get());
-    std::unique_ptr<State> state = std::make_unique<State>();
-    state->setSkills(std::move(skills));
-    state->setResources(std::move(resources));
-    Node root;
-    root.setState(std::move(state));
 
-    Explore::explore(&root, cPUCT, numPlayouts);
+    Explore::setCheckpoint(checkpointPath, checkpointInterval);
+    int fightLength = options.fightLength ? options.fightLength : 180000;
+    if (mode == "receding") Explore::exploreReceding(&root, cPUCT, numPlayouts, fightLength, numThreads);
+    else Explore::explore(&root, cPUCT, numPlayouts, numThreads);
 }
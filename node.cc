@@ -1,198 +1,1429 @@
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <new>
 #include <utility>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "puct.h"
+#include "rollout.h"
+#include "rng.h"
 #include "skill.h"
 #include "resources.h"
 #include "state.h"
 #include "node.h"
+#include "profile.h"
 
 struct NodeImpl {
 
-    Node* owner;
-
+    // A view of the i-th outgoing edge of a node
     class Edge final {
         private:
-            int N;
-            double W, Q;
-            const double P;
-
-            Node* parent;
-            std::unique_ptr<Node> child;
-
-            Skill* skill;
-            int time;
-
-            long totalSkillDamage;
-            int numDamageCalls;
+            NodeImpl* node;
+            int i;
 
         public:
-            Edge(Node* parent, double priorP, Skill* skill);
-            Edge(Node* parent, double priorP, int waitTime);
+            Edge(NodeImpl* node, int i);
 
-            Node* getParent() const;
+            NodeImpl* getParent() const;
 
-            Skill* getSkill() const;
+            // The index of the skill in the parent's state, or -1 for
+            //   the wait edge
+            int getSkill() const;
             int getTime() const;
 
-            void setChild(std::unique_ptr<Node>&& node);
-            Node* getChild() const;
+            NodeImpl* setChild(NodeImpl* child);
+            NodeImpl* getChild() const;
 
             int getN() const;
             double getQ() const;
             double getP() const;
 
-            int getSkillDamage();
+            // Samples the damage of the skill from the parent's state
+            //   and adds it to the average
+            int getSkillDamage(const State& parentState, Rng& rng);
             double getAverageSkillDamage() const;
 
-            void addValue(double value);
+            void addVirtualLoss(int virtualLoss);
+            void addValue(double value, int virtualLoss);
     };
 
-    std::unique_ptr<State> state;
+    // Nodes, their edges and their states all live in the arena of
+    //   the worker that created them, and are only destroyed
+    //   individually once they are cut off from the root (see
+    //   Node::commitBestEdge). Edge statistics and Nb are updated
+    //   atomically, since several threads may share a tree. With
+    //   transpositions a node may be reached through several edges,
+    //   so nodes do not point back at their parents. A node holds
+    //   either its own State object, or with flat states, a snapshot
+    //   that is loaded into a per-thread State when needed.
+    State* state = nullptr;
+    char* snapshot = nullptr;
 
-    Edge* parent = nullptr;
-    std::vector<std::unique_ptr<Edge>> children;
+    // The time elapsed from the root to this node, along any path
+    int elapsed = 0;
 
     int Nb = 0;
 
-    void initChildren();
+    // The statistics of the outgoing edges, stored as contiguous
+    //   arrays of numChildren entries each so that selection can
+    //   scan them without chasing pointers. The edges are those of
+    //   the available skills, then the wait edge, whose skill is -1,
+    //   unless it is pruned; with progressive widening, they are
+    //   sorted by prior (see SearchOptions::wideningFactor). Terminal
+    //   nodes, at or past the end of the fight, have no edges.
+    int numChildren = 0;
+
+    // The worker whose arena holds the node, and the last pass over
+    //   the tree that reached it (see SearchTree::prune)
+    int owner = 0;
+    unsigned mark = 0;
+
+    int* N = nullptr;
+    double* W = nullptr;
+    double* Q = nullptr;
+    double* P = nullptr;
+    NodeImpl** child = nullptr;
+    int* skill = nullptr;
+    int* time = nullptr;
+    double* totalSkillDamage = nullptr;
+    int* numDamageCalls = nullptr;
+
+    // Sets up the edges of the node in the given state. With outcomes
+    //   (scratch space for damage distributions), each skill edge
+    //   starts with the expected damage as its average instead of a
+    //   sample as its prior.
+    void initChildren(Arena& arena, const State& state, std::vector<int>& availableSkills, Rng& rng,
+                      std::vector<DamageOutcome>* outcomes, const SearchOptions& options);
+    void setChildren(char* block, int n);
+    void promote(int i);
+    void freeChildren(Arena& arena);
+    Edge edge(int i);
+};
+
+// Maps states reached at a given elapsed time to the node holding
+//   them, so that different orders of skills reaching the same state
+//   share a node. Including the elapsed time in the key keeps the
+//   graph acyclic, and keeps every edge value a dps over the same
+//   span of time. The table is split into shards with their own
+//   locks so that threads rarely contend.
+class TranspositionTable final {
+    private:
+        static constexpr int numShards = 64;
+
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_multimap<std::size_t, NodeImpl*> nodes;
+        };
+        Shard shards[numShards];
+
+        // non-zero if nodes hold snapshots of this size
+        std::size_t snapshotSize;
+
+    public:
+        explicit TranspositionTable(std::size_t snapshotSize);
+
+        // Return the node equal to the given one if there is one,
+        //   otherwise insert the given node and return it.
+        NodeImpl* findOrInsert(NodeImpl* node);
+};
+
+// Per-thread scratch space: the arena the thread allocates from, the
+//   generator its damage rolls are drawn from, the path taken by its
+//   current playout and the damage of each edge on it, with flat
+//   states, the State that snapshots are loaded into along with the
+//   node whose snapshot it currently holds, and the State that
+//   rollouts are played in along with the snapshot they start from,
+//   without, the State that unstored states are rebuilt in, and the
+//   counters of its playouts (see profile.h)
+struct Worker {
+    int id = 0;
+    Arena arena;
+    Rng rng;
+    std::vector<DamageOutcome> outcomes;
+    std::vector<std::pair<NodeImpl*, int>> path;
+    std::vector<double> damages;
+    std::vector<int> availableSkills;
+    std::unique_ptr<State> scratch;
+    const NodeImpl* loaded = nullptr;
+    std::unique_ptr<State> replay;
+    std::unique_ptr<State> rollout;
+    std::vector<char> rolloutStart;
+    Profile::Counters profile;
 };
 
-NodeImpl::Edge::Edge(Node* parent, double priorP, Skill* skill):
-    N{0}, W{0}, Q{0}, P{priorP}, parent{parent}, child{std::unique_ptr<Node>()},
-    skill{skill}, time{skill->getCastTime()}, totalSkillDamage{0}, numDamageCalls{0} {}
+struct SearchTree {
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::unique_ptr<State> rootState;
+    NodeImpl* root;
+    std::atomic<long> numNodes{1};
+    std::atomic<long> numTranspositions{0};
+    SearchOptions options;
+    int virtualLoss = 0;
+    std::size_t snapshotSize = 0;
+    bool exactDamage = false;
+    std::shared_ptr<const RolloutPolicy> rolloutPolicy;
+    std::unique_ptr<TranspositionTable> transpositions;
+
+    // With a memory budget, playouts hold the lock shared and pruning
+    //   holds it exclusively. Playouts wait to start while a thread
+    //   is waiting to prune, so that it is not starved.
+    std::shared_mutex pruneMutex;
+    std::atomic<int> numPruners{0};
+    std::atomic<long> numReclaimed{0};
+    unsigned epoch = 0;
+
+    // The checkpoint the tree was loaded from, if any. Loaded nodes
+    //   keep their edges and snapshots in the mapping.
+    char* mapping = nullptr;
+    std::size_t mappingSize = 0;
+
+    SearchTree(): workers(1), root{nullptr} {
+        workers[0] = std::make_unique<Worker>();
+        root = workers[0]->arena.make<NodeImpl>();
+    }
+    ~SearchTree();
+
+    void configure();
+    const State& view(Worker& worker, const NodeImpl* node);
+    State& advance(Worker& worker, const State& state, const NodeImpl* node, int edge);
+    void store(Worker& worker, NodeImpl* node, State& state);
+    NodeImpl* makeChild(Worker& worker, const State& state, NodeImpl* node, int edge, bool stored,
+                        const State** reached = nullptr);
+    void rollout(Worker& worker, const State& state, int elapsed, double& damage, double& time);
+    bool isTerminal(int elapsed) const;
+    int admitted(int numChildren, int Nb, double sqrtNb) const;
+    int withinFight(const NodeImpl* node, int time) const;
+    std::size_t bytesUsed() const;
+    bool overBudget() const;
+    void prune();
+    bool isMapped(const void* p) const;
+    void release(NodeImpl* node);
+    std::size_t releasedBytes(const NodeImpl* node) const;
+};
+
+namespace {
+    std::size_t hashBytes(const char* p, std::size_t size) {
+        std::size_t h = 0xcbf29ce484222325ULL;
+        for (std::size_t i = 0; i < size; i++) h = (h ^ static_cast<unsigned char>(p[i])) * 0x100000001b3ULL;
+        return h;
+    }
+}
+
+TranspositionTable::TranspositionTable(std::size_t snapshotSize): snapshotSize{snapshotSize} {}
+
+NodeImpl* TranspositionTable::findOrInsert(NodeImpl* node) {
+    std::size_t h = snapshotSize ? hashBytes(node->snapshot, snapshotSize) : node->state->hash();
+    std::size_t key = h ^ (static_cast<std::size_t>(node->elapsed) * 0x9e3779b97f4a7c15ULL);
+    Shard& shard = shards[key % numShards];
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    auto range = shard.nodes.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        NodeImpl* other = it->second;
+        if (other->elapsed != node->elapsed) continue;
+        if (snapshotSize ? std::memcmp(other->snapshot, node->snapshot, snapshotSize) == 0
+                         : other->state->equals(*node->state)) return other;
+    }
+    shard.nodes.emplace(key, node);
+    return node;
+}
+
+namespace {
+    template<typename T>
+    T atomicLoad(const T& x) {
+        T value;
+        __atomic_load(&x, &value, __ATOMIC_RELAXED);
+        return value;
+    }
+
+    template<typename T>
+    void atomicAdd(T& x, T delta) {
+        __atomic_fetch_add(&x, delta, __ATOMIC_RELAXED);
+    }
+
+    void atomicAdd(double& x, double delta) {
+        double expected = atomicLoad(x);
+        double desired = expected + delta;
+        while (!__atomic_compare_exchange(&x, &expected, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            desired = expected + delta;
+        }
+    }
+
+    void updateQ(double& Q, const double& W, const int& N) {
+        int visits = atomicLoad(N);
+        double value = visits > 0 ? atomicLoad(W) / visits : 0;
+        __atomic_store(&Q, &value, __ATOMIC_RELAXED);
+    }
+
+    // The expected damage of the skill at the given index, which must
+    //   declare a distribution, using outcomes as scratch space
+    double expectedDamage(const State& state, int index, std::vector<DamageOutcome>& outcomes) {
+        state.getDamageDistribution(index, outcomes);
+        double expected = 0;
+        for (const DamageOutcome& outcome : outcomes) expected += outcome.damage * outcome.probability;
+        return expected;
+    }
+}
 
-NodeImpl::Edge::Edge(Node* parent, double priorP, int waitTime):
-    N{0}, W{0}, Q{0}, P{priorP}, parent{parent}, child{std::unique_ptr<Node>()},
-    skill{nullptr}, time{waitTime}, totalSkillDamage{0}, numDamageCalls{0} {}
+NodeImpl::Edge::Edge(NodeImpl* node, int i): node{node}, i{i} {}
 
-Node* NodeImpl::Edge::getParent() const {return parent;}
+NodeImpl* NodeImpl::Edge::getParent() const {return node;}
 
-Skill* NodeImpl::Edge::getSkill() const {return skill;}
+int NodeImpl::Edge::getSkill() const {return node->skill[i];}
 
-int NodeImpl::Edge::getTime() const {return time;}
+int NodeImpl::Edge::getTime() const {return node->time[i];}
 
-void NodeImpl::Edge::setChild(std::unique_ptr<Node>&& node) {
-    child = std::move(node);
+// Installs the child unless another thread got there first, and
+//   returns the child that ended up installed
+NodeImpl* NodeImpl::Edge::setChild(NodeImpl* child) {
+    NodeImpl* expected = nullptr;
+    if (__atomic_compare_exchange_n(&node->child[i], &expected, child, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+        return child;
+    }
+    return expected;
 }
 
-Node* NodeImpl::Edge::getChild() const {return child ? child.get() : nullptr;}
+NodeImpl* NodeImpl::Edge::getChild() const {return __atomic_load_n(&node->child[i], __ATOMIC_ACQUIRE);}
 
-int NodeImpl::Edge::getN() const {return N;}
+int NodeImpl::Edge::getN() const {return atomicLoad(node->N[i]);}
 
-double NodeImpl::Edge::getQ() const {return Q;}
+double NodeImpl::Edge::getQ() const {return atomicLoad(node->Q[i]);}
 
-double NodeImpl::Edge::getP() const {return P;}
+double NodeImpl::Edge::getP() const {return node->P[i];}
 
-int NodeImpl::Edge::getSkillDamage() {
-    int damage = skill ? skill->getDamage() : 0;
-    totalSkillDamage += damage;
-    numDamageCalls++;
+int NodeImpl::Edge::getSkillDamage(const State& parentState, Rng& rng) {
+    int index = node->skill[i];
+    int damage = index >= 0 ? parentState.getDamage(index, rng) : 0;
+    atomicAdd(node->totalSkillDamage[i], static_cast<double>(damage));
+    atomicAdd(node->numDamageCalls[i], 1);
     return damage;
 }
 
 double NodeImpl::Edge::getAverageSkillDamage() const {
-    return numDamageCalls > 0 ? static_cast<double>(totalSkillDamage) / numDamageCalls : 0;
+    int numDamageCalls = atomicLoad(node->numDamageCalls[i]);
+    return numDamageCalls > 0 ? static_cast<double>(atomicLoad(node->totalSkillDamage[i])) / numDamageCalls : 0;
+}
+
+void NodeImpl::Edge::addVirtualLoss(int virtualLoss) {
+    atomicAdd(node->N[i], virtualLoss);
+    atomicAdd(node->Nb, virtualLoss);
+    updateQ(node->Q[i], node->W[i], node->N[i]);
 }
 
-void NodeImpl::Edge::addValue(double value) {
-    N++;
-    W += value;
-    Q = W / N;
+// Records a visit of the given value, taking back the virtual loss
+//   added when the edge was selected
+void NodeImpl::Edge::addValue(double value, int virtualLoss) {
+    atomicAdd(node->N[i], 1 - virtualLoss);
+    atomicAdd(node->Nb, 1 - virtualLoss);
+    atomicAdd(node->W[i], value);
+    updateQ(node->Q[i], node->W[i], node->N[i]);
 }
 
-Node::Node(): imp{std::make_unique<NodeImpl>()} {imp->owner = this;}
+NodeImpl::Edge NodeImpl::edge(int i) {return Edge{this, i};}
+
+Node::Node(): tree{std::make_unique<SearchTree>()} {}
 
+// Tearing down the tree only releases the arena's blocks
 Node::~Node() = default;
 
-void NodeImpl::initChildren() {
-    children.clear();
-    std::vector<Skill*> availableSkills = state->getAvailableSkills();
-    for (Skill* skill : availableSkills) {
-        children.emplace_back(std::make_unique<Edge>(owner, static_cast<double>(skill->getDamage()) / skill->getCastTime(), skill));
+namespace {
+    std::size_t arrayBytes(std::size_t size, int n) {
+        return (n * size + alignof(double) - 1) / alignof(double) * alignof(double);
     }
-    children.emplace_back(std::make_unique<Edge>(owner, 0, state->getWaitTime()));
+
+    std::size_t edgeBytes(int n) {
+        std::size_t bytes = 0;
+        for (std::size_t size : {sizeof(int), sizeof(double), sizeof(double), sizeof(double), sizeof(NodeImpl*),
+                                 sizeof(int), sizeof(int), sizeof(double), sizeof(int)}) {
+            bytes += arrayBytes(size, n);
+        }
+        return bytes;
+    }
+
+    template<typename T>
+    T* carve(char*& p, int n) {
+        T* array = reinterpret_cast<T*>(p);
+        p += arrayBytes(sizeof(T), n);
+        return array;
+    }
+}
+
+void NodeImpl::initChildren(Arena& arena, const State& state, std::vector<int>& availableSkills, Rng& rng,
+                            std::vector<DamageOutcome>* outcomes, const SearchOptions& options) {
+    state.getAvailableSkills(availableSkills);
+    int waitTime = state.getWaitTime();
+    bool wait = true;
+    if (options.pruneWaiting) {
+        for (int index : availableSkills) wait = wait && state.getCastTime(index) > waitTime;
+    }
+    int n = availableSkills.size() + wait;
+
+    setChildren(static_cast<char*>(arena.allocate(edgeBytes(n), alignof(double))), n);
+
+    for (int i = 0; i < n; i++) {
+        N[i] = 0;
+        W[i] = 0;
+        Q[i] = 0;
+        child[i] = nullptr;
+        totalSkillDamage[i] = 0;
+        numDamageCalls[i] = 0;
+    }
+    for (int i = 0; i < n - wait; i++) {
+        skill[i] = availableSkills[i];
+        time[i] = state.getCastTime(skill[i]);
+        if (outcomes) {
+            double expected = expectedDamage(state, skill[i], *outcomes);
+            totalSkillDamage[i] = expected;
+            numDamageCalls[i] = 1;
+            P[i] = expected / time[i];
+        } else {
+            P[i] = static_cast<double>(state.getDamage(skill[i], rng)) / time[i];
+        }
+    }
+    if (wait) {
+        skill[n - 1] = -1;
+        time[n - 1] = waitTime;
+        P[n - 1] = 0;
+    }
+
+    // with progressive widening, sort the edges by prior, moving them
+    //   through the statistics arrays, which are still all zero
+    if (options.wideningFactor > 0) {
+        std::vector<int>& order = availableSkills;
+        order.resize(n);
+        for (int i = 0; i < n; i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [this](int a, int b) {return P[a] > P[b] || (P[a] == P[b] && a < b);});
+        auto permute = [&](auto* array, auto* scratch) {
+            for (int i = 0; i < n; i++) scratch[i] = array[order[i]];
+            for (int i = 0; i < n; i++) array[i] = scratch[i];
+        };
+        permute(skill, N);
+        permute(time, N);
+        permute(numDamageCalls, N);
+        permute(P, Q);
+        permute(totalSkillDamage, Q);
+        for (int i = 0; i < n; i++) {
+            N[i] = 0;
+            Q[i] = 0;
+        }
+    }
+}
+
+// Points the edge arrays of n edges into the given block of
+//   edgeBytes(n) bytes, which may already hold them
+void NodeImpl::setChildren(char* block, int n) {
+    char* p = block;
+    N = carve<int>(p, n);
+    W = carve<double>(p, n);
+    Q = carve<double>(p, n);
+    P = carve<double>(p, n);
+    child = carve<NodeImpl*>(p, n);
+    skill = carve<int>(p, n);
+    time = carve<int>(p, n);
+    totalSkillDamage = carve<double>(p, n);
+    numDamageCalls = carve<int>(p, n);
+    numChildren = n;
+}
+
+// Moves the edge at the given index to the front, keeping the others
+//   in order, as when its prior is raised above all the others with
+//   progressive widening
+void NodeImpl::promote(int i) {
+    auto rotate = [i](auto* array) {std::rotate(array, array + i, array + i + 1);};
+    rotate(N);
+    rotate(W);
+    rotate(Q);
+    rotate(P);
+    rotate(child);
+    rotate(skill);
+    rotate(time);
+    rotate(totalSkillDamage);
+    rotate(numDamageCalls);
+}
+
+void NodeImpl::freeChildren(Arena& arena) {
+    if (numChildren) arena.deallocate(N, edgeBytes(numChildren), alignof(double));
+    numChildren = 0;
+}
+
+// The nodes go with the arenas, but their states may own memory
+//   outside of them, such as a share of the table of a kit file, so
+//   they are deleted first
+SearchTree::~SearchTree() {
+    unsigned found = ++epoch;
+    std::vector<NodeImpl*> stack{root};
+    root->mark = found;
+    while (!stack.empty()) {
+        NodeImpl* node = stack.back();
+        stack.pop_back();
+        if (node->state != rootState.get()) delete node->state;
+        for (int i = 0; i < node->numChildren; i++) {
+            NodeImpl* child = node->child[i];
+            if (child && child->mark != found) {
+                child->mark = found;
+                stack.emplace_back(child);
+            }
+        }
+    }
+    if (mapping) munmap(mapping, mappingSize);
+}
+
+bool SearchTree::isMapped(const void* p) const {
+    return mapping && p >= mapping && p < mapping + mappingSize;
+}
+
+// Frees a node that is not part of the tree. Whatever it keeps in a
+//   checkpoint mapping stays there until the tree is destroyed.
+void SearchTree::release(NodeImpl* node) {
+    Arena& arena = workers[node->owner]->arena;
+    if (!isMapped(node->N)) node->freeChildren(arena);
+    if (node->snapshot && !isMapped(node->snapshot)) arena.deallocate(node->snapshot, snapshotSize);
+    delete node->state;
+    arena.destroy(node);
+}
+
+// Returns the number of bytes in use that releasing the node frees
+std::size_t SearchTree::releasedBytes(const NodeImpl* node) const {
+    std::size_t bytes = Arena::chunkSize(sizeof(NodeImpl));
+    if (node->numChildren && !isMapped(node->N)) bytes += Arena::chunkSize(edgeBytes(node->numChildren));
+    if (node->snapshot && !isMapped(node->snapshot)) bytes += Arena::chunkSize(snapshotSize);
+    return bytes;
+}
+
+// Sets up the root and the per-thread scratch space from the root
+//   state and the options, whichever of the two was set last
+void SearchTree::configure() {
+    while (static_cast<int>(workers.size()) < options.numThreads) {
+        workers.emplace_back(std::make_unique<Worker>());
+        workers.back()->id = workers.size() - 1;
+    }
+    virtualLoss = options.numThreads > 1 ? options.virtualLoss : 0;
+    for (auto it = workers.begin(); it != workers.end(); ++it) (*it)->rng.seed(options.seed, (*it)->id);
+
+    // and so are expected damages
+    exactDamage = options.expectedDamage;
+    for (int i = 0; i < rootState->getNumSkills() && exactDamage; i++) {
+        exactDamage = rootState->getDamageDistribution(i, workers[0]->outcomes);
+    }
+    rolloutPolicy = options.rolloutPolicy ? options.rolloutPolicy : std::make_shared<GreedyRollout>();
+
+    // flat states are only used if every skill supports them
+    Worker& first = *workers[0];
+    if (root->snapshot) first.arena.deallocate(root->snapshot, snapshotSize);
+    snapshotSize = options.flatStates ? rootState->getSnapshotSize() : 0;
+    root->state = nullptr;
+    root->snapshot = nullptr;
+    if (snapshotSize) {
+        root->snapshot = static_cast<char*>(first.arena.allocate(snapshotSize));
+        rootState->saveSnapshot(root->snapshot);
+        for (auto it = workers.begin(); it != workers.end(); ++it) {
+            (*it)->scratch = std::unique_ptr<State>(rootState->copy());
+            (*it)->loaded = nullptr;
+            if (options.rollouts) {
+                (*it)->rollout = std::unique_ptr<State>(rootState->copy());
+                (*it)->rolloutStart.resize(snapshotSize);
+            }
+        }
+    } else {
+        root->state = rootState.get();
+    }
+    root->freeChildren(first.arena);
+    if (!isTerminal(root->elapsed)) {
+        root->initChildren(first.arena, *rootState, first.availableSkills, first.rng,
+                           exactDamage ? &first.outcomes : nullptr, options);
+    }
+
+    transpositions.reset();
+    if (options.transpositions) {
+        transpositions = std::make_unique<TranspositionTable>(snapshotSize);
+        transpositions->findOrInsert(root);
+    }
+}
+
+// Returns the state of the node, loading its snapshot into the
+//   worker's scratch state if needed
+const State& SearchTree::view(Worker& worker, const NodeImpl* node) {
+    if (node->state) return *node->state;
+    if (worker.loaded != node) {
+        Profile::Time timer{Profile::StateCopy};
+        worker.scratch->loadSnapshot(node->snapshot);
+        worker.loaded = node;
+    }
+    return *worker.scratch;
+}
+
+// Returns the state reached by taking the given edge of the node whose
+//   state is passed in, built in the worker's scratch space. The
+//   state passed in must be one returned by view() or advance().
+State& SearchTree::advance(Worker& worker, const State& state, const NodeImpl* node, int edge) {
+    State* next;
+    if (snapshotSize) {
+        next = worker.scratch.get();
+        worker.loaded = nullptr;
+    } else {
+        if (&state != worker.replay.get()) {
+            Profile::Time timer{Profile::StateCopy};
+            Arena::Scope scope{&worker.arena};
+            worker.replay.reset(state.copy());
+        }
+        next = worker.replay.get();
+    }
+    int index = node->skill[edge];
+    Profile::Time timer{Profile::UseSkill};
+    next->useSkill(index, node->time[edge]);
+    return *next;
+}
+
+// Makes the node keep the given state, which must be the one last
+//   returned by advance() for the worker
+void SearchTree::store(Worker& worker, NodeImpl* node, State& state) {
+    if (snapshotSize) {
+        Profile::Time timer{Profile::StateCopy};
+        node->snapshot = static_cast<char*>(workers[node->owner]->arena.allocate(snapshotSize));
+        state.saveSnapshot(node->snapshot);
+        worker.loaded = node;
+    } else {
+        node->state = worker.replay.release();
+    }
+}
+
+// Builds the node reached by taking the given edge from a node with
+//   the given state, which must be one returned by view() or
+//   advance(). The new node is not linked into the tree. If reached is
+//   given, it is set to the state of the new node, which stays valid
+//   until the worker next builds a state or the node is released.
+NodeImpl* SearchTree::makeChild(Worker& worker, const State& state, NodeImpl* node, int edge, bool stored,
+                                const State** reached) {
+    Arena::Scope scope{&worker.arena};
+    NodeImpl* newNode = worker.arena.make<NodeImpl>();
+    newNode->owner = worker.id;
+    State& newState = advance(worker, state, node, edge);
+    newNode->elapsed = node->elapsed + node->time[edge];
+    if (!isTerminal(newNode->elapsed)) {
+        Profile::Time timer{Profile::InitChildren};
+        newNode->initChildren(worker.arena, newState, worker.availableSkills, worker.rng,
+                              exactDamage ? &worker.outcomes : nullptr, options);
+    }
+    if (stored) store(worker, newNode, newState);
+    if (reached) *reached = newNode->state ? newNode->state : &newState;
+    return newNode;
+}
+
+// Returns whether nodes reached after the given time are terminal
+bool SearchTree::isTerminal(int elapsed) const {
+    return options.fightLength && elapsed >= options.fightLength;
+}
+
+// Returns the number of edges of a node with the given number of edges
+//   and visits that take part in selection, the first ones (see
+//   SearchOptions::wideningFactor)
+int SearchTree::admitted(int numChildren, int Nb, double sqrtNb) const {
+    if (options.wideningFactor <= 0) return numChildren;
+    double power = options.wideningExponent == 0.5 ? sqrtNb : std::pow(Nb, options.wideningExponent);
+    int n = std::ceil(options.wideningFactor * power);
+    return std::min(numChildren, std::max(n, 1));
+}
+
+// Returns the part of the given time from the node that falls within
+//   the fight
+int SearchTree::withinFight(const NodeImpl* node, int time) const {
+    if (options.fightLength && node->elapsed + time > options.fightLength) return options.fightLength - node->elapsed;
+    return time;
+}
+
+// Plays the rollouts from the given state, which must be one returned
+//   by makeChild() for a node reached after the given time, and adds
+//   the damage they deal and the time they take within the fight,
+//   averaged over the rollouts, to the given totals. With flat states
+//   every rollout starts from a snapshot loaded into the worker's
+//   rollout State; otherwise from a copy on the heap, so that nothing
+//   is left in the arena.
+void SearchTree::rollout(Worker& worker, const State& state, int elapsed, double& damage, double& time) {
+    const RolloutPolicy& policy = *rolloutPolicy;
+    int left = options.fightLength ? options.fightLength - elapsed : options.rolloutHorizon;
+    int horizon = std::min(options.rolloutHorizon, left);
+    if (snapshotSize) state.saveSnapshot(worker.rolloutStart.data());
+    std::unique_ptr<State> copy;
+    double totalDamage = 0;
+    long totalTime = 0;
+    for (int r = 0; r < options.rollouts; r++) {
+        State* current;
+        if (snapshotSize) {
+            worker.rollout->loadSnapshot(worker.rolloutStart.data());
+            current = worker.rollout.get();
+        } else {
+            copy.reset(state.copy());
+            current = copy.get();
+        }
+        int played = 0;
+        while (played < horizon) {
+            current->getAvailableSkills(worker.availableSkills);
+            int index = worker.availableSkills.empty() ? -1
+                                                       : policy.choose(*current, worker.availableSkills, worker.rng);
+            int castTime = index >= 0 ? current->getCastTime(index) : current->getWaitTime();
+            if (index >= 0) {
+                totalDamage += exactDamage ? expectedDamage(*current, index, worker.outcomes)
+                                           : current->getDamage(index, worker.rng);
+            }
+            current->useSkill(index, castTime);
+            played += castTime;
+        }
+        totalTime += options.fightLength ? std::min(played, left) : played;
+    }
+    damage += totalDamage / options.rollouts;
+    time += static_cast<double>(totalTime) / options.rollouts;
 }
 
 void Node::setState(std::unique_ptr<State>&& state) {
-    this->imp->state = std::move(state);
-}
-
-void Node::playout(double c) {
-    if (imp->children.empty()) imp->initChildren();
-
-    // Selection phase
-    Node* currNode = this;
-    NodeImpl::Edge* edgeToTake = nullptr;
-    double maxEdgeValue = -1;
-    do {
-        maxEdgeValue = -1;
-        for (auto it = currNode->imp->children.begin(); it != currNode->imp->children.end(); ++it) {
-            NodeImpl::Edge* thisEdge = (*it).get();
-            double thisEdgeValue = thisEdge->getQ() + c * thisEdge->getP() * sqrt(imp->Nb) / (1 + thisEdge->getN());
-            if (thisEdgeValue > maxEdgeValue) {
-                edgeToTake = thisEdge;
-                maxEdgeValue = thisEdgeValue;
+    tree->rootState = std::move(state);
+    tree->configure();
+}
+
+void Node::setOptions(const SearchOptions& options) {
+    tree->options = options;
+    if (tree->rootState) tree->configure();
+}
+
+std::size_t SearchTree::bytesUsed() const {
+    std::size_t bytes = mappingSize;
+    for (auto it = workers.begin(); it != workers.end(); ++it) bytes += (*it)->arena.getBytesInUse();
+    return bytes;
+}
+
+// Returns whether the tree is to be pruned: whether it takes up more
+//   than its memory budget, less room for a node from each thread,
+//   which other threads may add before pruning starts
+bool SearchTree::overBudget() const {
+    std::size_t bytes = bytesUsed();
+    std::size_t nodeBytes = bytes / std::max(numNodes.load(std::memory_order_relaxed), 1L);
+    return bytes + nodeBytes * options.numThreads > options.memoryBudget;
+}
+
+// Frees the least visited subtrees until the tree takes up at most
+//   three quarters of the memory budget. The edges leading to them
+//   keep their statistics, so selection treats them as before, and
+//   they are expanded again if selected. Must be called with the
+//   prune lock held exclusively.
+void SearchTree::prune() {
+    std::size_t target = options.memoryBudget / 4 * 3;
+    std::vector<NodeImpl*> nodes;
+    long reclaimed = 0;
+    for (std::size_t bytes = bytesUsed(); bytes > target; bytes = bytesUsed()) {
+
+        // find every node, and every edge leading to one
+        unsigned found = ++epoch;
+        nodes.assign(1, root);
+        struct Cut {
+            int N;
+            NodeImpl* parent;
+            int i;
+        };
+        std::vector<Cut> edges;
+        std::unordered_map<const NodeImpl*, int> numParents;
+        std::size_t nodeBytes = 0;
+        long numStates = 0;
+        root->mark = found;
+        for (std::size_t k = 0; k < nodes.size(); k++) {
+            NodeImpl* node = nodes[k];
+            nodeBytes += releasedBytes(node);
+            numStates += node->state != nullptr;
+            for (int i = 0; i < node->numChildren; i++) {
+                NodeImpl* child = node->child[i];
+                if (!child) continue;
+                edges.push_back(Cut{node->N[i], node, i});
+                if (transpositions) numParents[child]++;
+                if (child->mark != found) {
+                    child->mark = found;
+                    nodes.emplace_back(child);
+                }
+            }
+        }
+
+        // the size of states is not known, so what is in use beyond the
+        //   nodes themselves is taken to be their states, in equal
+        //   parts, and another round is cut if that falls short
+        std::size_t stateBytes = bytes > mappingSize + nodeBytes && numStates
+                                 ? (bytes - mappingSize - nodeBytes) / numStates : 0;
+
+        // cut the least visited edges until the nodes left without a
+        //   parent by them, and so freed, take up the bytes to free.
+        //   With transpositions a node is only freed once every edge
+        //   leading to it is cut or leaves a freed node. Edges leaving
+        //   a node already freed are passed over.
+        std::stable_sort(edges.begin(), edges.end(), [](const Cut& a, const Cut& b) {return a.N < b.N;});
+        std::size_t toFree = bytes - target;
+        unsigned cut = ++epoch;
+        auto orphaned = [&](const NodeImpl* node) {return !transpositions || --numParents[node] == 0;};
+        std::vector<NodeImpl*> stack;
+        for (auto it = edges.begin(); it != edges.end() && toFree > 0; ++it) {
+            if (it->parent->mark == cut) continue;
+            NodeImpl* child = it->parent->child[it->i];
+            it->parent->child[it->i] = nullptr;
+            if (!orphaned(child)) continue;
+            stack.assign(1, child);
+            while (!stack.empty()) {
+                NodeImpl* node = stack.back();
+                stack.pop_back();
+                node->mark = cut;
+                toFree -= std::min(toFree, releasedBytes(node) + (node->state ? stateBytes : 0));
+                for (int i = 0; i < node->numChildren; i++) {
+                    NodeImpl* next = node->child[i];
+                    if (next && orphaned(next)) stack.emplace_back(next);
+                }
             }
         }
-        currNode = edgeToTake->getChild();
-    } while (currNode);
 
-    // Expansion phase
-    currNode = edgeToTake->getParent();
-    std::unique_ptr<Node> newNode = std::make_unique<Node>();
-    std::unordered_map<Skill*, Skill*> oldToNew;
-    newNode->imp->state = std::unique_ptr<State>(currNode->imp->state->copy(oldToNew));
-    newNode->imp->state->useSkill(oldToNew[edgeToTake->getSkill()], edgeToTake->getTime());
-    newNode->imp->parent = edgeToTake;
-    newNode->imp->initChildren();
-    newNode->imp->Nb = 0;
-    edgeToTake->setChild(std::move(newNode));
+        // then free every node that can no longer be reached from the root
+        unsigned reached = ++epoch;
+        stack.assign(1, root);
+        root->mark = reached;
+        while (!stack.empty()) {
+            NodeImpl* node = stack.back();
+            stack.pop_back();
+            for (int i = 0; i < node->numChildren; i++) {
+                NodeImpl* child = node->child[i];
+                if (child && child->mark != reached) {
+                    child->mark = reached;
+                    stack.emplace_back(child);
+                }
+            }
+        }
+        std::size_t kept = 0;
+        for (NodeImpl* node : nodes) {
+            if (node->mark == reached) nodes[kept++] = node;
+            else release(node);
+        }
+        long freed = nodes.size() - kept;
+        nodes.resize(kept);
+        numNodes -= freed;
+        reclaimed += freed;
+        if (!freed) break;
+    }
+    if (!reclaimed) return;
+    numReclaimed += reclaimed;
+    for (auto it = workers.begin(); it != workers.end(); ++it) (*it)->loaded = nullptr;
+
+    if (transpositions) {
+        transpositions = std::make_unique<TranspositionTable>(snapshotSize);
+        for (NodeImpl* node : nodes) {
+            if (node->state || node->snapshot) transpositions->findOrInsert(node);
+        }
+    }
+}
+
+void Node::playout(double c, int thread) {
+    Worker& worker = *tree->workers[thread];
+    std::vector<std::pair<NodeImpl*, int>>& path = worker.path;
+    int virtualLoss = tree->virtualLoss;
+
+    std::shared_lock<std::shared_mutex> lock;
+    if (tree->options.memoryBudget) {
+        while (tree->numPruners.load(std::memory_order_acquire)) std::this_thread::yield();
+        lock = std::shared_lock<std::shared_mutex>{tree->pruneMutex};
+    }
+
+    Profile::Scope counting{&worker.profile};
+
+    // once the fight is over there is nothing left to search
+    if (!tree->root->numChildren) return;
+
+    // Selection phase, which ends at an edge without a child, or at
+    //   one leading to a terminal node
+    Profile::Time selection{Profile::Selection};
+    path.clear();
+    NodeImpl* currNode = tree->root;
+    int edgeToTake = 0;
+    bool terminal = false;
+    while (true) {
+        int Nb = atomicLoad(currNode->Nb);
+        double sqrtNb = sqrt(Nb);
+        int n = tree->admitted(currNode->numChildren, Nb, sqrtNb);
+        edgeToTake = PUCT::select(currNode->Q, currNode->P, currNode->N, n, c * sqrtNb);
+        path.emplace_back(currNode, edgeToTake);
+        NodeImpl::Edge edge = currNode->edge(edgeToTake);
+        if (virtualLoss) edge.addVirtualLoss(virtualLoss);
+        NodeImpl* nextNode = edge.getChild();
+        if (!nextNode) break;
+        if (!nextNode->numChildren) {
+            terminal = true;
+            break;
+        }
+        currNode = nextNode;
+    }
+    selection.stop();
+
+    // Walk the path again to find the damage of every edge on it,
+    //   rebuilding the states of nodes that do not store one by
+    //   replaying the edges from the nearest node that does. With
+    //   expected damages, every edge already holds its damage, so only
+    //   the state of the last node is rebuilt, for the expansion.
+    Profile::Time evaluation{Profile::Evaluation};
+    std::vector<double>& damages = worker.damages;
+    damages.resize(path.size());
+    const State* state = nullptr;
+    if (tree->exactDamage && terminal) {
+        for (std::size_t i = 0; i < path.size(); i++) {
+            damages[i] = path[i].first->edge(path[i].second).getAverageSkillDamage();
+        }
+    } else if (tree->exactDamage) {
+        std::size_t first = path.size() - 1;
+        while (!path[first].first->state && !path[first].first->snapshot) first--;
+        state = &tree->view(worker, path[first].first);
+        for (std::size_t i = first + 1; i < path.size(); i++) {
+            state = &tree->advance(worker, *state, path[i - 1].first, path[i - 1].second);
+        }
+        for (std::size_t i = 0; i < path.size(); i++) {
+            damages[i] = path[i].first->edge(path[i].second).getAverageSkillDamage();
+        }
+    } else {
+        for (std::size_t i = 0; i < path.size(); i++) {
+            NodeImpl* node = path[i].first;
+            if (node->state || node->snapshot) state = &tree->view(worker, node);
+            else state = &tree->advance(worker, *state, path[i - 1].first, path[i - 1].second);
+            damages[i] = node->edge(path[i].second).getSkillDamage(*state, worker.rng);
+        }
+    }
+    evaluation.stop();
+
+    // Expansion phase, where only nodes at every k-th depth keep
+    //   their state, unless the playout ended at a terminal node
+    double accumDamage = 0;
+    double accumTime = 0;
+    if (!terminal) {
+        Profile::Time expansion{Profile::Expansion};
+        bool stored = path.size() % tree->options.materializeEvery == 0;
+        const State* reached = nullptr;
+        NodeImpl* newNode = tree->makeChild(worker, *state, currNode, edgeToTake, stored, &reached);
+
+        // if the state was already reached in another way, link to the
+        //   existing node instead. Once our node is in the table, any
+        //   other thread expanding the same edge finds and links it.
+        //   Nodes without a stored state cannot be compared, so they
+        //   are never shared. Either way, a discarded node is only
+        //   released once the rollouts are done with its state.
+        NodeImpl* found = tree->transpositions && stored ? tree->transpositions->findOrInsert(newNode) : newNode;
+        bool discarded = currNode->edge(edgeToTake).setChild(found) != newNode;
+        if (!discarded) {
+            tree->numNodes.fetch_add(1, std::memory_order_relaxed);
+        } else if (found != newNode) {
+            // a transposition, rather than another thread expanding
+            //   the same edge first
+            tree->numTranspositions.fetch_add(1, std::memory_order_relaxed);
+        }
+        expansion.stop();
+
+        // Rollout phase, which plays on from the new node to estimate
+        //   what follows it
+        if (tree->options.rollouts && newNode->numChildren) {
+            Profile::Time rollout{Profile::Rollout};
+            tree->rollout(worker, *reached, newNode->elapsed, accumDamage, accumTime);
+        }
+        if (discarded) {
+            if (worker.loaded == newNode) worker.loaded = nullptr;
+            tree->release(newNode);
+        }
+    }
 
     // Backpropagation phase
-    NodeImpl::Edge* currEdge = edgeToTake;
-    int accumDamage = 0, accumTime = 0;
-    do {
-        accumDamage += currEdge->getSkillDamage();
-        accumTime += currEdge->getTime();
-        double dps = static_cast<double>(accumDamage) / accumTime;
-        currEdge->addValue(dps);
-        (currEdge->getParent()->imp->Nb)++;
-        currEdge = currEdge->getParent()->imp->parent;
-    } while (currEdge);
+    Profile::Time backpropagation{Profile::Backpropagation};
+    long branching = 0;
+    for (std::size_t i = path.size(); i-- > 0;) {
+        NodeImpl::Edge currEdge = path[i].first->edge(path[i].second);
+        accumDamage += damages[i];
+        accumTime += tree->withinFight(path[i].first, currEdge.getTime());
+        double dps = accumDamage / accumTime;
+        currEdge.addValue(dps, virtualLoss);
+        if (Profile::enabled) branching += path[i].first->numChildren;
+    }
+    backpropagation.stop();
+    Profile::countPlayout(path.size(), branching);
+
+    // Check whether the tree has outgrown its budget after every
+    //   playout, which is only a few loads, so that it never does by
+    //   more than the playouts in flight
+    if (tree->options.memoryBudget && tree->overBudget()) {
+        lock.unlock();
+        tree->numPruners.fetch_add(1, std::memory_order_acq_rel);
+        {
+            std::unique_lock<std::shared_mutex> exclusive{tree->pruneMutex};
+            if (tree->overBudget()) tree->prune();
+        }
+        tree->numPruners.fetch_sub(1, std::memory_order_acq_rel);
+    }
 }
 
 std::pair<std::string, double> Node::currentBestPath() {
-    if (imp->children.empty()) imp->initChildren();
+    std::shared_lock<std::shared_mutex> lock;
+    if (tree->options.memoryBudget) lock = std::shared_lock<std::shared_mutex>{tree->pruneMutex};
+    NodeImpl* root = tree->root;
 
     std::string path = "";
-    int damage = 0;
+    double damage = 0;
     int time = 0;
-    Node* currNode = this;
-    NodeImpl::Edge* edgeToTake = nullptr;
-    double maxEdgeVisits = -1;
-
-    do {
-        maxEdgeVisits = -1;
-        for (auto it = currNode->imp->children.begin(); it != currNode->imp->children.end(); ++it) {
-            NodeImpl::Edge* thisEdge = (*it).get();
-            if (thisEdge->getN() > maxEdgeVisits) {
-                edgeToTake = thisEdge;
-                maxEdgeVisits = thisEdge->getN();
-            }
+    NodeImpl* currNode = root;
+
+    while (currNode && currNode->numChildren) {
+        NodeImpl::Edge edgeToTake = currNode->edge(PUCT::mostVisited(currNode->N, currNode->numChildren));
+        if (edgeToTake.getSkill() >= 0) {
+            path += tree->rootState->toString(edgeToTake.getSkill()) + " ";
+            damage += edgeToTake.getAverageSkillDamage();
         }
-        if (edgeToTake->getSkill()) {
-            path += edgeToTake->getSkill()->toString() + " ";
-            damage += edgeToTake->getAverageSkillDamage();
+        time += edgeToTake.getTime();
+        currNode = edgeToTake.getChild();
+    }
+
+    if (tree->options.fightLength) time = tree->options.fightLength - root->elapsed;
+    double dps = time > 0 ? damage / time : 0;
+
+    return std::pair<std::string, double>{path, dps};
+}
+
+std::pair<std::string, double> Node::currentBestPath(const std::vector<Node*>& trees) {
+    std::string path = "";
+    double damage = 0;
+    int time = 0;
+    std::vector<NodeImpl*> currNodes;
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    for (Node* tree : trees) {
+        if (tree->tree->options.memoryBudget) locks.emplace_back(tree->tree->pruneMutex);
+        if (tree->tree->root->numChildren) currNodes.emplace_back(tree->tree->root);
+    }
+
+    // the trees were grown from identical states, so corresponding
+    //   nodes have edges for the same skills, though with progressive
+    //   widening not in the same order, so edges are matched by skill
+    auto find = [](const NodeImpl* node, int skill) {
+        int i = 0;
+        while (node->skill[i] != skill) i++;
+        return i;
+    };
+    std::vector<long> mergedN;
+    while (!currNodes.empty()) {
+        int numChildren = currNodes[0]->numChildren;
+        mergedN.assign(numChildren, 0);
+        for (NodeImpl* node : currNodes) {
+            for (int i = 0; i < numChildren; i++) mergedN[i] += node->edge(find(node, currNodes[0]->skill[i])).getN();
+        }
+        int edgeToTake = 0;
+        for (int i = 1; i < numChildren; i++) {
+            if (mergedN[i] > mergedN[edgeToTake]) edgeToTake = i;
         }
-        time += edgeToTake->getTime();
-        currNode = edgeToTake->getChild();
-    } while (currNode);
 
-    double dps = time > 0 ? static_cast<double>(damage) / time : 0;
+        double totalSkillDamage = 0;
+        long numDamageCalls = 0;
+        std::vector<NodeImpl*> nextNodes;
+        for (NodeImpl* node : currNodes) {
+            int i = find(node, currNodes[0]->skill[edgeToTake]);
+            NodeImpl::Edge edge = node->edge(i);
+            totalSkillDamage += atomicLoad(node->totalSkillDamage[i]);
+            numDamageCalls += atomicLoad(node->numDamageCalls[i]);
+            if (edge.getChild() && edge.getChild()->numChildren) nextNodes.emplace_back(edge.getChild());
+        }
+
+        NodeImpl::Edge edge = currNodes[0]->edge(edgeToTake);
+        if (edge.getSkill() >= 0) {
+            path += trees[0]->tree->rootState->toString(edge.getSkill()) + " ";
+            damage += numDamageCalls > 0 ? totalSkillDamage / numDamageCalls : 0;
+        }
+        time += edge.getTime();
+        currNodes = std::move(nextNodes);
+    }
+
+    const SearchTree& first = *trees[0]->tree;
+    if (first.options.fightLength) time = first.options.fightLength - first.root->elapsed;
+    double dps = time > 0 ? damage / time : 0;
 
     return std::pair<std::string, double>{path, dps};
 }
+
+std::pair<std::string, double> Node::commitBestEdge() {
+    Worker& worker = *tree->workers[0];
+    NodeImpl* root = tree->root;
+    int edgeToTake = PUCT::mostVisited(root->N, root->numChildren);
+    NodeImpl::Edge edge = root->edge(edgeToTake);
+
+    // the new root must keep its state, since there is nothing above
+    //   it left to replay from
+    NodeImpl* newRoot = edge.getChild();
+    const State& state = tree->view(worker, root);
+    if (!newRoot) {
+        newRoot = tree->makeChild(worker, state, root, edgeToTake, true);
+        edge.setChild(newRoot);
+        tree->numNodes++;
+    } else if (!newRoot->state && !newRoot->snapshot) {
+        tree->store(worker, newRoot, tree->advance(worker, state, root, edgeToTake));
+    }
+
+    std::string skill = edge.getSkill() >= 0 ? tree->rootState->toString(edge.getSkill()) : "";
+    double damage = edge.getSkill() >= 0 ? edge.getAverageSkillDamage() : 0;
+
+    // With transpositions the nodes below the old root form a graph,
+    //   so the nodes still reachable from the new root are found first
+    std::unordered_set<NodeImpl*> kept{newRoot};
+    std::vector<NodeImpl*> stack;
+    if (tree->transpositions) {
+        stack.emplace_back(newRoot);
+        while (!stack.empty()) {
+            NodeImpl* node = stack.back();
+            stack.pop_back();
+            for (int i = 0; i < node->numChildren; i++) {
+                if (node->child[i] && kept.insert(node->child[i]).second) stack.emplace_back(node->child[i]);
+            }
+        }
+    }
+
+    // collect everything else below the old root before freeing any
+    //   of it, since a node may be reached again through another edge
+    std::unordered_set<NodeImpl*> seen{root};
+    std::vector<NodeImpl*> unreachable;
+    stack.emplace_back(root);
+    while (!stack.empty()) {
+        NodeImpl* node = stack.back();
+        stack.pop_back();
+        unreachable.emplace_back(node);
+        for (int i = 0; i < node->numChildren; i++) {
+            NodeImpl* child = node->child[i];
+            if (!child || kept.count(child)) continue;
+            if (tree->transpositions && !seen.insert(child).second) continue;
+            stack.emplace_back(child);
+        }
+    }
+    for (NodeImpl* node : unreachable) {
+        if (node->state == tree->rootState.get()) node->state = nullptr;
+        tree->release(node);
+    }
+    tree->numNodes -= unreachable.size();
+    for (auto it = tree->workers.begin(); it != tree->workers.end(); ++it) (*it)->loaded = nullptr;
+    tree->root = newRoot;
+
+    if (tree->transpositions) {
+        tree->transpositions = std::make_unique<TranspositionTable>(tree->snapshotSize);
+        for (NodeImpl* node : kept) {
+            if (node->state || node->snapshot) tree->transpositions->findOrInsert(node);
+        }
+    }
+
+    return std::pair<std::string, double>{skill, damage};
+}
+
+void Node::seedPriors(const std::vector<int>& skills, double weight) {
+    Worker& worker = *tree->workers[0];
+    NodeImpl* node = tree->root;
+    const State* state = &tree->view(worker, node);
+    for (int skill : skills) {
+        int i = 0;
+        while (i < node->numChildren && node->skill[i] != skill) i++;
+        if (i == node->numChildren) break;
+        node->P[i] += weight * *std::max_element(node->P, node->P + node->numChildren);
+        if (tree->options.wideningFactor > 0) {
+            node->promote(i);
+            i = 0;
+        }
+
+        NodeImpl::Edge edge = node->edge(i);
+        NodeImpl* child = edge.getChild();
+        if (!child) {
+            child = tree->makeChild(worker, *state, node, i, true);
+            NodeImpl* found = tree->transpositions ? tree->transpositions->findOrInsert(child) : child;
+            if (found != child) {
+                if (worker.loaded == child) worker.loaded = nullptr;
+                tree->release(child);
+                tree->numTranspositions++;
+            } else {
+                tree->numNodes++;
+            }
+            edge.setChild(found);
+            child = found;
+        }
+        state = child->state || child->snapshot ? &tree->view(worker, child) : &tree->advance(worker, *state, node, i);
+        node = child;
+    }
+}
+
+int Node::elapsed() const {return tree->root->elapsed;}
+
+// A checkpoint is a header, a record for every node (the root first),
+//   the edge arrays of every node laid out exactly as in memory, then
+//   the snapshots of the nodes that keep one. Child pointers are
+//   stored as node numbers plus one (0 for none) and every other
+//   field as is, so loading maps the file and points the nodes into
+//   it, translating only the child pointers in place.
+namespace {
+    constexpr char checkpointMagic[8] = {'A', 'A', 'T', 'R', 'E', 'E', '\0', '\0'};
+    constexpr std::uint32_t checkpointVersion = 3;
+
+    struct CheckpointHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t snapshotSize;
+        std::uint32_t numSkills;
+        std::uint32_t reserved;
+        std::uint64_t numNodes;
+        std::uint64_t numTranspositions;
+        std::uint64_t numReclaimed;
+        std::uint64_t size;
+        std::uint64_t fingerprint;
+    };
+
+    struct CheckpointNode {
+        std::int32_t elapsed;
+        std::int32_t Nb;
+        std::int32_t numChildren;
+        std::int32_t stored;
+        std::uint64_t edges;
+        std::uint64_t snapshot;
+    };
+
+    // A hash of the state the search starts from and of what the search
+    //   sees of its kit: the name, cast time and damage distribution of
+    //   every skill. States of different kits of the same shape may
+    //   hash the same, as their hashes only cover what changes.
+    std::uint64_t fingerprint(const State& state) {
+        std::uint64_t h = state.hash();
+        auto mix = [&h](std::uint64_t x) {h = (h ^ x) * 0x100000001b3ULL;};
+        std::vector<DamageOutcome> outcomes;
+        for (int i = 0; i < state.getNumSkills(); i++) {
+            std::string name = state.toString(i);
+            mix(hashBytes(name.data(), name.size()));
+            mix(state.getCastTime(i));
+            if (!state.getDamageDistribution(i, outcomes)) continue;
+            for (const DamageOutcome& outcome : outcomes) {
+                std::uint64_t bits;
+                std::memcpy(&bits, &outcome.probability, sizeof(bits));
+                mix(outcome.damage);
+                mix(bits);
+            }
+        }
+        return h;
+    }
+
+    std::uint64_t align(std::uint64_t offset) {
+        return (offset + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    }
+}
+
+bool Node::saveCheckpoint(const std::string& path) {
+
+    // with a memory budget, subtrees may be freed during playouts, so
+    //   they are paused for the duration
+    std::unique_lock<std::shared_mutex> lock;
+    if (tree->options.memoryBudget) {
+        tree->numPruners.fetch_add(1, std::memory_order_acq_rel);
+        lock = std::unique_lock<std::shared_mutex>{tree->pruneMutex};
+    }
+
+    // number the nodes
+    std::vector<NodeImpl*> nodes{tree->root};
+    std::unordered_map<NodeImpl*, std::uint64_t> numbers{{tree->root, 0}};
+    for (std::size_t k = 0; k < nodes.size(); k++) {
+        for (int i = 0; i < nodes[k]->numChildren; i++) {
+            NodeImpl* child = nodes[k]->edge(i).getChild();
+            if (child && numbers.emplace(child, nodes.size()).second) nodes.emplace_back(child);
+        }
+    }
+
+    // snapshots are saved if the states support them, in either mode
+    std::size_t snapshotSize = tree->rootState->getSnapshotSize();
+    std::vector<CheckpointNode> records(nodes.size());
+    std::uint64_t offset = align(sizeof(CheckpointHeader) + records.size() * sizeof(CheckpointNode));
+    for (std::size_t k = 0; k < nodes.size(); k++) {
+        records[k].elapsed = nodes[k]->elapsed;
+        records[k].Nb = atomicLoad(nodes[k]->Nb);
+        records[k].numChildren = nodes[k]->numChildren;
+        records[k].edges = offset;
+        offset = align(offset + edgeBytes(nodes[k]->numChildren));
+    }
+    for (std::size_t k = 0; k < nodes.size(); k++) {
+        records[k].stored = snapshotSize && (nodes[k]->state || nodes[k]->snapshot);
+        records[k].snapshot = records[k].stored ? offset : 0;
+        if (records[k].stored) offset = align(offset + snapshotSize);
+    }
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = checkpointVersion;
+    header.snapshotSize = snapshotSize;
+    header.numSkills = tree->rootState->getNumSkills();
+    header.numNodes = nodes.size();
+    header.numTranspositions = tree->numTranspositions;
+    header.numReclaimed = tree->numReclaimed;
+    header.size = offset;
+    header.fingerprint = fingerprint(*tree->rootState);
+
+    // write to a temporary file first, so that a crash while saving
+    //   leaves the previous checkpoint intact
+    std::string temporary = path + ".tmp";
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    std::vector<char> buffer;
+    auto pad = [&]() {
+        if (!out) return;
+        buffer.assign(align(out.tellp()) - out.tellp(), 0);
+        out.write(buffer.data(), buffer.size());
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CheckpointNode));
+    pad();
+    for (NodeImpl* node : nodes) {
+        int n = node->numChildren;
+        buffer.assign(edgeBytes(n), 0);
+        NodeImpl copy;
+        copy.setChildren(buffer.data(), n);
+        for (int i = 0; i < n; i++) {
+            copy.N[i] = atomicLoad(node->N[i]);
+            copy.W[i] = atomicLoad(node->W[i]);
+            copy.Q[i] = atomicLoad(node->Q[i]);
+            copy.P[i] = node->P[i];
+            NodeImpl* child = node->edge(i).getChild();
+            auto it = child ? numbers.find(child) : numbers.end();
+            std::uint64_t number = it != numbers.end() ? it->second + 1 : 0;
+            std::memcpy(&copy.child[i], &number, sizeof(number));
+            copy.skill[i] = node->skill[i];
+            copy.time[i] = node->time[i];
+            copy.totalSkillDamage[i] = atomicLoad(node->totalSkillDamage[i]);
+            copy.numDamageCalls[i] = atomicLoad(node->numDamageCalls[i]);
+        }
+        out.write(buffer.data(), buffer.size());
+        pad();
+    }
+    buffer.resize(snapshotSize);
+    for (std::size_t k = 0; k < nodes.size(); k++) {
+        if (!records[k].stored) continue;
+        if (nodes[k]->snapshot) out.write(nodes[k]->snapshot, snapshotSize);
+        else {
+            nodes[k]->state->saveSnapshot(buffer.data());
+            out.write(buffer.data(), snapshotSize);
+        }
+        pad();
+    }
+    out.close();
+
+    if (tree->options.memoryBudget) {
+        lock.unlock();
+        tree->numPruners.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    return out && std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool Node::loadCheckpoint(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    void* p = fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(CheckpointHeader))
+        ? mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (p == MAP_FAILED) return false;
+    char* mapping = static_cast<char*>(p);
+    std::size_t size = info.st_size;
+
+    // the checkpoint must come from an equal state, as far as can be told
+    const CheckpointHeader& header = *reinterpret_cast<const CheckpointHeader*>(mapping);
+    std::size_t snapshotSize = tree->rootState->getSnapshotSize();
+    bool valid = std::memcmp(header.magic, checkpointMagic, sizeof(header.magic)) == 0
+        && header.version == checkpointVersion && header.size == size && header.numNodes > 0
+        && header.snapshotSize == snapshotSize
+        && header.numSkills == static_cast<std::uint32_t>(tree->rootState->getNumSkills())
+        && header.fingerprint == fingerprint(*tree->rootState)
+        && sizeof(CheckpointHeader) + header.numNodes * sizeof(CheckpointNode) <= size;
+    const CheckpointNode* records = reinterpret_cast<const CheckpointNode*>(mapping + sizeof(CheckpointHeader));
+    for (std::uint64_t k = 0; valid && k < header.numNodes; k++) {
+        valid = records[k].numChildren >= 0 && records[k].edges % alignof(double) == 0
+            && records[k].edges + edgeBytes(records[k].numChildren) <= size
+            && (!records[k].stored || records[k].snapshot + snapshotSize <= size);
+    }
+
+    // a root away from the initial state can only be restored from
+    //   its snapshot
+    valid = valid && (records[0].elapsed == 0 || records[0].stored);
+    if (!valid) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    Worker& first = *tree->workers[0];
+    NodeImpl* root = tree->root;
+    root->freeChildren(first.arena);
+    if (root->snapshot) first.arena.deallocate(root->snapshot, tree->snapshotSize);
+    root->snapshot = nullptr;
+    root->state = nullptr;
+
+    std::vector<NodeImpl*> nodes(header.numNodes);
+    for (std::uint64_t k = 0; k < header.numNodes; k++) {
+        NodeImpl* node = k == 0 ? root : first.arena.make<NodeImpl>();
+        node->elapsed = records[k].elapsed;
+        node->Nb = records[k].Nb;
+        node->setChildren(mapping + records[k].edges, records[k].numChildren);
+        if (records[k].stored && tree->snapshotSize) node->snapshot = mapping + records[k].snapshot;
+        nodes[k] = node;
+    }
+    // without flat states only the root keeps a state, and every other
+    //   one is rebuilt by replaying from it when needed
+    if (!tree->snapshotSize && records[0].elapsed != 0) {
+        root->state = tree->rootState->copy();
+        root->state->loadSnapshot(mapping + records[0].snapshot);
+    } else if (!tree->snapshotSize) {
+        root->state = tree->rootState.get();
+    }
+
+    for (NodeImpl* node : nodes) {
+        for (int i = 0; i < node->numChildren; i++) {
+            std::uint64_t number;
+            std::memcpy(&number, &node->child[i], sizeof(number));
+            node->child[i] = number > 0 && number <= nodes.size() ? nodes[number - 1] : nullptr;
+        }
+    }
+
+    tree->mapping = mapping;
+    tree->mappingSize = size;
+    tree->numNodes = header.numNodes;
+    tree->numTranspositions = header.numTranspositions;
+    tree->numReclaimed = header.numReclaimed;
+    for (auto it = tree->workers.begin(); it != tree->workers.end(); ++it) (*it)->loaded = nullptr;
+    if (tree->transpositions) {
+        tree->transpositions = std::make_unique<TranspositionTable>(tree->snapshotSize);
+        for (NodeImpl* node : nodes) {
+            if (node->state || node->snapshot) tree->transpositions->findOrInsert(node);
+        }
+    }
+    return true;
+}
+
+long Node::size() const {return tree->numNodes;}
+
+long Node::numTranspositions() const {return tree->numTranspositions;}
+
+long Node::numReclaimed() const {return tree->numReclaimed;}
+
+Profile::Counters Node::profile() const {
+    Profile::Counters total;
+    for (auto it = tree->workers.begin(); it != tree->workers.end(); ++it) {
+        const Profile::Counters& counters = (*it)->profile;
+        Profile::Counters copy;
+        copy.playouts = atomicLoad(counters.playouts);
+        for (int t = 0; t < Profile::NumTimers; t++) copy.nanoseconds[t] = atomicLoad(counters.nanoseconds[t]);
+        copy.depth = atomicLoad(counters.depth);
+        copy.branching = atomicLoad(counters.branching);
+        copy.maxDepth = atomicLoad(counters.maxDepth);
+        copy.skillCalls = atomicLoad(counters.skillCalls);
+        total += copy;
+    }
+    return total;
+}
+
+std::size_t Node::bytesUsed() const {return tree->bytesUsed();}
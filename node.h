@@ -2,16 +2,124 @@
 #define _NODE_H_
 
 #include <string>
+#include <vector>
 #include <memory>
+#include <cstddef>
+#include <cstdint>
 
 #include "state.h"
+#include "profile.h"
 
-struct NodeImpl;
+struct SearchTree;
+class RolloutPolicy;
+
+struct SearchOptions {
+
+    // The number of threads that may call playout() on the same
+    //   tree at once. They must pass distinct thread numbers from
+    //   0 to numThreads - 1.
+    int numThreads = 1;
+
+    // The number of visits (of zero value) temporarily added to
+    //   every edge a playout passes through until the playout is
+    //   backpropagated, so that concurrent playouts are steered
+    //   towards different paths. Only used with multiple threads.
+    int virtualLoss = 3;
+
+    // Whether nodes reaching identical states (as determined by
+    //   State::equals) after the same elapsed time are shared, which
+    //   turns the tree into a directed acyclic graph.
+    bool transpositions = false;
+
+    // Whether nodes store a flat snapshot of their state instead of
+    //   a State object of their own, if every skill and the resources
+    //   support snapshots (see Skill::getBlock). Copying a state is
+    //   then a single memcpy, and the observers are set up only once
+    //   per thread instead of once per node.
+    bool flatStates = false;
+
+    // Only nodes whose depth is a multiple of this keep their state
+    //   (or snapshot); the states of other nodes are rebuilt when
+    //   needed by replaying the edges from the nearest node above
+    //   them that kept one. Larger values use less memory per node
+    //   but more time per playout. Nodes that do not keep their
+    //   state are never shared as transpositions. Must be positive.
+    int materializeEvery = 1;
+
+    // The number of bytes the tree may take up (see
+    //   Node::bytesUsed), or 0 for no limit. Once the tree grows past
+    //   it, the least visited subtrees are freed until it takes up
+    //   three quarters of the budget. The edges leading to them keep
+    //   their statistics, and are expanded again if selected. Freed
+    //   memory is reused by the tree rather than returned to the
+    //   system.
+    std::size_t memoryBudget = 0;
+
+    // Whether edges take the expected damage of their skill, computed
+    //   once from the distribution it declares (see
+    //   Skill::getDamageDistribution), instead of averaging a sample
+    //   of getDamage() taken on every visit. This removes the noise of
+    //   damage rolls from the priors and values. Only used if every
+    //   skill declares a distribution.
+    bool expectedDamage = false;
+
+    // The number of rollouts played from every node added to the
+    //   tree. A rollout uses the skills chosen by the rollout policy
+    //   until rolloutHorizon time has passed, on a state of the
+    //   thread's own, without adding to the tree. The playout then
+    //   values the path to the new node as if it were followed by the
+    //   average damage and time of its rollouts, rather than ending
+    //   at the node. With expected damages, rollouts also take the
+    //   expected damage of every skill instead of a roll.
+    int rollouts = 0;
+    int rolloutHorizon = 30000;
+
+    // The policy of the rollouts, or nullptr for a GreedyRollout (see
+    //   rollout.h)
+    std::shared_ptr<const RolloutPolicy> rolloutPolicy;
+
+    // The time at which the fight ends, counted from the state passed
+    //   to setState, or 0 for a fight without end. Nodes reached at or
+    //   after it are terminal: they have no edges and are never
+    //   expanded, and a playout that selects an edge leading to one
+    //   stops there. Only the time within the fight counts towards the
+    //   values of edges, so that a path reaching the end is valued at
+    //   the damage it deals until then (a skill cast before the end
+    //   counts in full) over the time left in the fight, and rollouts
+    //   also stop at the end.
+    int fightLength = 0;
+
+    // Progressive widening, for kits of many skills: with a positive
+    //   wideningFactor, only the edges of a node with the highest
+    //   priors take part in selection, wideningFactor times Nb to the
+    //   power wideningExponent of them (at least one), so that edges
+    //   are admitted in order of prior as the node is visited, and
+    //   playouts go deep before they go wide. The edges of every node
+    //   are then kept in decreasing order of prior, ties (such as the
+    //   wait edge and skills that deal no damage) in their usual order.
+    double wideningFactor = 0;
+    double wideningExponent = 0.5;
+
+    // Whether the wait edge is left out of nodes where some skill can
+    //   be cast in the time the wait takes, such as a filler without a
+    //   cooldown. Casting it instead reaches the next change of state
+    //   as soon or sooner while dealing damage, which is nearly always
+    //   better; not always, as the skill may spend what a later skill
+    //   needs, so it is not done by default.
+    bool pruneWaiting = false;
+
+    // The seed of the generators that damage rolls are drawn from
+    //   (see Skill::getDamage). Every thread draws from a stream of
+    //   its own, so a search on one thread always grows the same tree
+    //   from the same seed; with several threads, only the order in
+    //   which their playouts interleave varies.
+    std::uint64_t seed = 0;
+};
 
 class Node final {
 
     private:
-        std::unique_ptr<NodeImpl> imp;
+        std::unique_ptr<SearchTree> tree;
 
     public:
         Node();
@@ -24,11 +132,20 @@ class Node final {
         //   also undefined.
         void setState(std::unique_ptr<State>&& state);
 
+        // Set the options used by the search. This method may be
+        //   called before or after setState, but must be called before
+        //   any playouts are performed, otherwise behaviour is
+        //   undefined.
+        void setOptions(const SearchOptions& options);
+
         // Performs a single iteration of a Monte-Carlo playout, using
         //   c as the value of cPUCT (the degree to which exploration
         //   is preferred). The tree rooted at this node increases in
-        //   size by exactly one node.
-        void playout(double c);
+        //   size by at most one node (none if the state reached is
+        //   already in the transposition table). Playouts may be run
+        //   concurrently from as many threads as set in the options,
+        //   each passing its own thread number.
+        void playout(double c, int thread = 0);
 
         // Get a string representing the current optimal path from
         //   the root to any leaf and the total dps of this path. The
@@ -36,8 +153,91 @@ class Node final {
         //   node taking the edge with the highest visit count (from all
         //   the playouts) until a leaf node is reached. The string is
         //   constructed by concatenating the string representations of
-        //   the skills in the edges of this path.
+        //   the skills in the edges of this path. With a fight length,
+        //   the dps is the damage of the path over the whole time left
+        //   in the fight from this node, so that it measures the total
+        //   damage of the fight and is comparable between runs. This
+        //   method may be called while playouts are running on other
+        //   threads.
         std::pair<std::string, double> currentBestPath();
+
+        // Get the current optimal path of an ensemble of trees that
+        //   were searched independently from identical states, in
+        //   the same form as currentBestPath(). At each node the
+        //   visit counts and damage statistics of the corresponding
+        //   edges are summed over every tree that reaches that node,
+        //   and the edge with the highest merged visit count is taken.
+        //   This method may be called while playouts are running.
+        static std::pair<std::string, double> currentBestPath(const std::vector<Node*>& trees);
+
+        // Commit to the edge of the root with the highest visit count:
+        //   its child becomes the new root, keeping its subtree and
+        //   statistics, and every node no longer reachable from it is
+        //   freed. Returns the string representation of the skill of
+        //   the edge (empty for waiting) and its average damage. This
+        //   method must not be called while playouts are running, nor
+        //   once the root is terminal (see SearchOptions::fightLength).
+        std::pair<std::string, double> commitBestEdge();
+
+        // Make the search try the given rotation first, as found by
+        //   BeamSearch or Solver (see beam.h), with -1 standing for
+        //   waiting. Following the rotation from the root, the prior
+        //   of the edge of each skill in turn is raised by weight times
+        //   the highest prior of its node, and the node it leads to is
+        //   added if it is not in the tree yet. Stops at the first skill
+        //   that is not available, or at the end of the fight. This
+        //   method must not be called while playouts are running.
+        void seedPriors(const std::vector<int>& skills, double weight);
+
+        // Save the tree rooted at this node (its edge statistics and
+        //   the snapshots of the states it keeps, if the states support
+        //   them) to a binary checkpoint at the given path, replacing
+        //   it only once the new one is complete. May be called while
+        //   playouts are running. Returns false if the file could not
+        //   be written.
+        bool saveCheckpoint(const std::string& path);
+
+        // Replace the tree rooted at this node with the one saved in
+        //   the checkpoint at the given path, to resume the search or
+        //   inspect it. The file is mapped into memory rather than
+        //   parsed, so loading takes time proportional to the number
+        //   of nodes only. setState and setOptions must be called
+        //   first, with a state equal to the one the checkpoint was
+        //   searched from; playouts must not be running. Returns
+        //   false, leaving the tree untouched, if the file is not a
+        //   checkpoint of a state with the same number of skills,
+        //   snapshot size and hash, whose skills have the same names,
+        //   cast times and damage distributions. Without flat states
+        //   only the root keeps its state; the others are rebuilt when
+        //   needed.
+        bool loadCheckpoint(const std::string& path);
+
+        // Return the time elapsed from the state passed to setState
+        //   to the current root, through every committed edge.
+        int elapsed() const;
+
+        // Return the number of nodes in the tree rooted at this node.
+        long size() const;
+
+        // Return the number of expansions that reached an existing
+        //   node through the transposition table instead of adding
+        //   a new one.
+        long numTranspositions() const;
+
+        // Return the number of nodes freed to keep the tree within
+        //   its memory budget.
+        long numReclaimed() const;
+
+        // Return the counters and timers of every playout run on
+        //   this tree so far, summed over its threads. They are all
+        //   zero unless profiling is compiled in (see profile.h). May
+        //   be called while playouts are running.
+        Profile::Counters profile() const;
+
+        // Return the number of bytes taken up by the tree rooted at
+        //   this node (its nodes, edges and states), excluding the
+        //   state passed to setState.
+        std::size_t bytesUsed() const;
 };
 
 #endif
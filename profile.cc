@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <string>
+
+#include "profile.h"
+
+namespace Profile {
+
+    Counters& Counters::operator+=(const Counters& other) {
+        playouts += other.playouts;
+        for (int t = 0; t < NumTimers; t++) nanoseconds[t] += other.nanoseconds[t];
+        depth += other.depth;
+        branching += other.branching;
+        if (other.maxDepth > maxDepth) maxDepth = other.maxDepth;
+        skillCalls += other.skillCalls;
+        return *this;
+    }
+
+    const char* name(Timer timer) {
+        switch (timer) {
+            case Selection: return "selection";
+            case Evaluation: return "evaluation";
+            case Expansion: return "expansion";
+            case Rollout: return "rollout";
+            case Backpropagation: return "backpropagation";
+            case StateCopy: return "state_copy";
+            case UseSkill: return "use_skill";
+            case InitChildren: return "init_children";
+            default: return "";
+        }
+    }
+
+    std::string toJson(const Counters& counters) {
+        double playouts = counters.playouts > 0 ? counters.playouts : 1;
+        char buffer[64];
+        std::string json = "{\"playouts\": " + std::to_string(counters.playouts) + ", \"ns\": {";
+        for (int t = 0; t < NumTimers; t++) {
+            std::snprintf(buffer, sizeof(buffer), "%s\"%s\": %.1f", t > 0 ? ", " : "",
+                          name(static_cast<Timer>(t)), counters.nanoseconds[t] / playouts);
+            json += buffer;
+        }
+        std::snprintf(buffer, sizeof(buffer), "}, \"depth\": %.2f", counters.depth / playouts);
+        json += buffer;
+        std::snprintf(buffer, sizeof(buffer), ", \"max_depth\": %ld", counters.maxDepth);
+        json += buffer;
+        double depth = counters.depth > 0 ? counters.depth : 1;
+        std::snprintf(buffer, sizeof(buffer), ", \"branching\": %.2f", counters.branching / depth);
+        json += buffer;
+        std::snprintf(buffer, sizeof(buffer), ", \"skill_calls\": %.1f}", counters.skillCalls / playouts);
+        json += buffer;
+        return json;
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <chrono>
+#include <string>
+
+// Counters and timers for the phases of a playout. They are only
+//   collected when the program is built with AUTO_PROFILE defined
+//   (make PROFILE=1 after a make clean); otherwise every function
+//   here is empty and the counters stay at zero.
+namespace Profile {
+
+#ifdef AUTO_PROFILE
+    constexpr bool enabled = true;
+#else
+    constexpr bool enabled = false;
+#endif
+
+    // The phases of a playout, followed by the operations on states
+    //   that happen within them. Evaluation is the walk down the
+    //   selected path that finds the damage of every edge on it.
+    enum Timer {Selection, Evaluation, Expansion, Rollout, Backpropagation, StateCopy, UseSkill, InitChildren, NumTimers};
+
+    // Totals over every playout counted. Each thread counts into its
+    //   own, which other threads may read (see Node::profile).
+    struct Counters {
+        long playouts = 0;
+        long nanoseconds[NumTimers] = {};
+
+        // The number of edges selected, the number of edges of every
+        //   node passed through, and the most edges any one playout
+        //   selected
+        long depth = 0;
+        long branching = 0;
+        long maxDepth = 0;
+
+        // The number of calls to the virtual methods of skills
+        long skillCalls = 0;
+
+        Counters& operator+=(const Counters& other);
+    };
+
+    // Returns the name of the timer, as used in reports
+    const char* name(Timer timer);
+
+    // Returns the counters as a JSON object, with every timer and
+    //   count averaged per playout
+    std::string toJson(const Counters& counters);
+
+#ifdef AUTO_PROFILE
+    // The counters of the calling thread, or nullptr if it is not
+    //   running a playout
+    inline thread_local Counters* current = nullptr;
+
+    // Counters are only written by their own thread, so a relaxed
+    //   load and store is enough to keep readers from tearing them
+    inline void add(long& x, long delta) {
+        __atomic_store_n(&x, __atomic_load_n(&x, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+    }
+#endif
+
+    // Counts the given number of calls to the virtual methods of
+    //   skills made by the calling thread
+    inline void countSkillCalls([[maybe_unused]] long n) {
+#ifdef AUTO_PROFILE
+        if (current) add(current->skillCalls, n);
+#endif
+    }
+
+    // Counts a playout that selected the given number of edges from
+    //   nodes with the given total number of edges
+    inline void countPlayout([[maybe_unused]] long depth, [[maybe_unused]] long branching) {
+#ifdef AUTO_PROFILE
+        if (!current) return;
+        add(current->playouts, 1);
+        add(current->depth, depth);
+        add(current->branching, branching);
+        if (depth > current->maxDepth) add(current->maxDepth, depth - current->maxDepth);
+#endif
+    }
+
+    // Makes the given counters current on the calling thread for the
+    //   lifetime of the scope object
+    class Scope final {
+#ifdef AUTO_PROFILE
+        private:
+            Counters* prev;
+        public:
+            explicit Scope(Counters* counters): prev{current} {current = counters;}
+            ~Scope() {current = prev;}
+#else
+        public:
+            explicit Scope(Counters*) {}
+#endif
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+    };
+
+    // Adds the time from its construction to its destruction (or to
+    //   the call to stop) to the given timer of the current counters
+    class Time final {
+#ifdef AUTO_PROFILE
+        private:
+            Timer timer;
+            std::chrono::steady_clock::time_point start;
+            bool running = true;
+        public:
+            explicit Time(Timer timer): timer{timer}, start{std::chrono::steady_clock::now()} {}
+            ~Time() {stop();}
+            void stop() {
+                if (!running || !current) return;
+                running = false;
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                add(current->nanoseconds[timer], std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+#else
+        public:
+            explicit Time(Timer) {}
+            void stop() {}
+#endif
+            Time(const Time&) = delete;
+            Time& operator=(const Time&) = delete;
+    };
+}
+
+#endif
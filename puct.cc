@@ -0,0 +1,74 @@
+#include <limits>
+#include <immintrin.h>
+
+#include "puct.h"
+
+namespace {
+
+    constexpr double lowest = std::numeric_limits<double>::lowest();
+
+    int selectScalar(const double* Q, const double* P, const int* N, int begin, int n, double cSqrtNb, int best, double bestValue) {
+        for (int i = begin; i < n; i++) {
+            double value = Q[i] + cSqrtNb * P[i] / (1 + N[i]);
+            if (value > bestValue) {
+                best = i;
+                bestValue = value;
+            }
+        }
+        return best;
+    }
+
+    __attribute__((target("avx2")))
+    int selectAVX2(const double* Q, const double* P, const int* N, int n, double cSqrtNb) {
+        const __m256d c = _mm256_set1_pd(cSqrtNb);
+        const __m256d one = _mm256_set1_pd(1);
+        const __m256d four = _mm256_set1_pd(4);
+        __m256d index = _mm256_set_pd(3, 2, 1, 0);
+        __m256d bestValues = _mm256_set1_pd(lowest);
+        __m256d bestIndices = _mm256_set1_pd(-1);
+
+        // keep the best value seen by each lane, along with its index
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d q = _mm256_loadu_pd(Q + i);
+            __m256d p = _mm256_loadu_pd(P + i);
+            __m256d visits = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(N + i)));
+            __m256d value = _mm256_add_pd(q, _mm256_div_pd(_mm256_mul_pd(c, p), _mm256_add_pd(one, visits)));
+            __m256d greater = _mm256_cmp_pd(value, bestValues, _CMP_GT_OQ);
+            bestValues = _mm256_blendv_pd(bestValues, value, greater);
+            bestIndices = _mm256_blendv_pd(bestIndices, index, greater);
+            index = _mm256_add_pd(index, four);
+        }
+
+        // reduce across lanes, preferring the lowest index on ties
+        alignas(32) double values[4], indices[4];
+        _mm256_store_pd(values, bestValues);
+        _mm256_store_pd(indices, bestIndices);
+        int best = -1;
+        double bestValue = lowest;
+        for (int lane = 0; lane < 4; lane++) {
+            if (indices[lane] < 0) continue;
+            if (values[lane] > bestValue || (values[lane] == bestValue && indices[lane] < best)) {
+                best = static_cast<int>(indices[lane]);
+                bestValue = values[lane];
+            }
+        }
+
+        return selectScalar(Q, P, N, i, n, cSqrtNb, best, bestValue);
+    }
+
+    const bool hasAVX2 = __builtin_cpu_supports("avx2");
+}
+
+int PUCT::select(const double* Q, const double* P, const int* N, int n, double cSqrtNb) {
+    int best = hasAVX2 ? selectAVX2(Q, P, N, n, cSqrtNb) : selectScalar(Q, P, N, 0, n, cSqrtNb, -1, lowest);
+    return best >= 0 ? best : 0;
+}
+
+int PUCT::mostVisited(const int* N, int n) {
+    int best = 0;
+    for (int i = 1; i < n; i++) {
+        if (N[i] > N[best]) best = i;
+    }
+    return best;
+}
@@ -0,0 +1,18 @@
+#ifndef _PUCT_H_
+#define _PUCT_H_
+
+struct PUCT {
+
+    // Return the index i in [0, n) maximizing the PUCT value
+    //   Q[i] + cSqrtNb * P[i] / (1 + N[i]), where cSqrtNb is cPUCT
+    //   times the square root of the parent's visit count. Ties are
+    //   broken in favour of the lowest index. n must be positive.
+    //   Uses AVX2 when the processor supports it.
+    static int select(const double* Q, const double* P, const int* N, int n, double cSqrtNb);
+
+    // Return the index i in [0, n) maximizing N[i], with ties broken
+    //   in favour of the lowest index. n must be positive.
+    static int mostVisited(const int* N, int n);
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include <string>
+#include <ostream>
+#include <curses.h>
+
+#include "memcheck.h"
+#include "reporter.h"
+
+namespace {
+    long playoutsPerSecond(const Progress& progress) {
+        return progress.seconds > 0 ? static_cast<long>(progress.iteration / progress.seconds) : 0;
+    }
+}
+
+Reporter::~Reporter() {}
+
+CursesReporter::CursesReporter() {
+    initscr();
+    noecho();
+}
+
+CursesReporter::~CursesReporter() {endwin();}
+
+void CursesReporter::report(const Progress& progress) {
+    move(0, 0); printw("---------------------------------------------------");
+    move(1, 0); printw(("Total Virtual Memory: " + std::to_string(MemCheck::getTotalVirtualMem())).c_str());
+    move(2, 0); printw(("Total Physical Memory: " + std::to_string(MemCheck::getTotalPhysicalMem())).c_str());
+    move(3, 0); printw("---------------------------------------------------");
+    move(4, 0); printw(("Virtual Memory In Use By Process: " + std::to_string(progress.processVirtualMem)).c_str());
+    move(5, 0); printw(("Physical Memory In Use By Process: " + std::to_string(progress.processPhysicalMem)).c_str());
+    move(6, 0); printw("---------------------------------------------------");
+    move(7, 0); printw(("Tree Nodes: " + std::to_string(progress.numNodes)).c_str());
+    move(8, 0); printw(("Nodes Reclaimed: " + std::to_string(progress.numReclaimed)).c_str());
+    move(9, 0); printw(("Bytes Per Node: " + std::to_string(progress.bytesUsed / progress.numNodes)).c_str());
+    move(10, 0); printw("---------------------------------------------------");
+    move(11, 0); printw(("Iteration: " + std::to_string(progress.iteration)).c_str());
+    move(12, 0); printw(("Threads: " + std::to_string(progress.numThreads)).c_str());
+    move(13, 0); printw(("Playouts Per Second: " + (progress.seconds > 0 ? std::to_string(playoutsPerSecond(progress)) : "")).c_str());
+    move(14, 0); printw(("Theoretical DPS: " + (progress.iteration > 0 ? std::to_string(progress.dps) : "")).c_str());
+    move(15, 0); printw(("Best Rotation: " + progress.rotation).c_str());
+    if (Profile::enabled) {
+        const Profile::Counters& counters = progress.profile;
+        long playouts = counters.playouts > 0 ? counters.playouts : 1;
+        int line = 16;
+        move(line++, 0); printw("---------------------------------------------------");
+        for (int t = 0; t < Profile::NumTimers; t++) {
+            std::string name = Profile::name(static_cast<Profile::Timer>(t));
+            move(line++, 0); printw(("Nanoseconds In " + name + ": " + std::to_string(counters.nanoseconds[t] / playouts)).c_str());
+        }
+        move(line++, 0); printw(("Average Depth: " + std::to_string(static_cast<double>(counters.depth) / playouts)).c_str());
+        move(line++, 0); printw(("Maximum Depth: " + std::to_string(counters.maxDepth)).c_str());
+        move(line++, 0); printw(("Average Branching: " + std::to_string(static_cast<double>(counters.branching) / (counters.depth > 0 ? counters.depth : 1))).c_str());
+        move(line++, 0); printw(("Skill Calls Per Playout: " + std::to_string(static_cast<double>(counters.skillCalls) / playouts)).c_str());
+    }
+    clrtobot();
+    refresh();
+}
+
+JsonReporter::JsonReporter(std::ostream& out): out{out} {}
+
+void JsonReporter::report(const Progress& progress) {
+    std::string rotation = "";
+    for (char c : progress.rotation) {
+        if (c == '"' || c == '\\') rotation += '\\';
+        rotation += c;
+    }
+    out << "{\"iteration\": " << progress.iteration
+        << ", \"threads\": " << progress.numThreads
+        << ", \"seconds\": " << progress.seconds
+        << ", \"playouts_per_sec\": " << playoutsPerSecond(progress)
+        << ", \"dps\": " << progress.dps
+        << ", \"nodes\": " << progress.numNodes
+        << ", \"reclaimed\": " << progress.numReclaimed
+        << ", \"bytes_used\": " << progress.bytesUsed
+        << ", \"rss\": " << progress.processPhysicalMem
+        << ", \"rotation\": \"" << rotation << "\"";
+    if (Profile::enabled) out << ", \"profile\": " << Profile::toJson(progress.profile);
+    out << "}" << std::endl;
+}
+
+CsvReporter::CsvReporter(std::ostream& out): out{out} {
+    out << "iteration,threads,seconds,playouts_per_sec,dps,nodes,reclaimed,bytes_used,rss,rotation";
+    if (Profile::enabled) {
+        for (int t = 0; t < Profile::NumTimers; t++) out << ',' << Profile::name(static_cast<Profile::Timer>(t)) << "_ns";
+        out << ",depth,max_depth,branching,skill_calls";
+    }
+    out << std::endl;
+}
+
+void CsvReporter::report(const Progress& progress) {
+    std::string rotation = "";
+    for (char c : progress.rotation) {
+        if (c == '"') rotation += '"';
+        rotation += c;
+    }
+    out << progress.iteration << ',' << progress.numThreads << ',' << progress.seconds << ','
+        << playoutsPerSecond(progress) << ',' << progress.dps << ',' << progress.numNodes << ','
+        << progress.numReclaimed << ',' << progress.bytesUsed << ',' << progress.processPhysicalMem << ','
+        << '"' << rotation << '"';
+    if (Profile::enabled) {
+        const Profile::Counters& counters = progress.profile;
+        double playouts = counters.playouts > 0 ? counters.playouts : 1;
+        for (int t = 0; t < Profile::NumTimers; t++) out << ',' << counters.nanoseconds[t] / playouts;
+        out << ',' << counters.depth / playouts << ',' << counters.maxDepth << ','
+            << static_cast<double>(counters.branching) / (counters.depth > 0 ? counters.depth : 1) << ','
+            << counters.skillCalls / playouts;
+    }
+    out << std::endl;
+}
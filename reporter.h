@@ -0,0 +1,69 @@
+#ifndef _REPORTER_H_
+#define _REPORTER_H_
+
+#include <cstddef>
+#include <string>
+#include <ostream>
+
+#include "profile.h"
+
+// A snapshot of the progress of an exploration
+struct Progress {
+    long iteration = 0;
+    int numThreads = 1;
+    double seconds = 0;
+    long numNodes = 0;
+    long numReclaimed = 0;
+    std::size_t bytesUsed = 0;
+    long processVirtualMem = 0;
+    long processPhysicalMem = 0;
+    std::string rotation = "";
+    double dps = 0;
+
+    // Only collected when profiling is compiled in (see profile.h)
+    Profile::Counters profile;
+};
+
+// A consumer of the progress of an exploration. Reports are made from
+//   a thread of their own while the search runs, so that reporting
+//   never stalls it.
+class Reporter {
+
+    public:
+        virtual ~Reporter();
+
+        // Called with every snapshot, in order, and never from more
+        //   than one thread at a time
+        virtual void report(const Progress& progress) = 0;
+};
+
+// Draws the progress in a curses display, which is open for the
+//   lifetime of the object
+class CursesReporter final : public Reporter {
+    public:
+        CursesReporter();
+        ~CursesReporter();
+        void report(const Progress& progress) override;
+};
+
+// Writes every snapshot to the given stream as a JSON object on a
+//   line of its own
+class JsonReporter final : public Reporter {
+    private:
+        std::ostream& out;
+    public:
+        explicit JsonReporter(std::ostream& out);
+        void report(const Progress& progress) override;
+};
+
+// Writes every snapshot to the given stream as a CSV row, after a
+//   header row
+class CsvReporter final : public Reporter {
+    private:
+        std::ostream& out;
+    public:
+        explicit CsvReporter(std::ostream& out);
+        void report(const Progress& progress) override;
+};
+
+#endif
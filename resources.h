@@ -1,7 +1,11 @@
 #ifndef _RESOURCES_H_
 #define _RESOURCES_H_
 
-struct Resources {
+#include <cstddef>
+
+#include "arena.h"
+
+struct Resources : public ArenaAllocated {
 
     virtual ~Resources() {};
 
@@ -19,6 +23,27 @@ struct Resources {
 
     // Return an exact (deep) copy of the object
     virtual Resources* copy() const = 0;
+
+    // Return a hash of the internal fields of the object.
+    //   Resources for which equals() returns true must have
+    //   equal hashes.
+    virtual std::size_t hash() const = 0;
+
+    // Return true if the internal fields of the object are
+    //   identical to those of the resources passed in, so that
+    //   the two would behave identically from now on. The
+    //   resources passed in are always of the same class.
+    virtual bool equals(const Resources* other) const = 0;
+
+    // OPTIONAL: Return a pointer to a single block of plain data
+    //   holding every internal field of the object that can change
+    //   after construction, and set size to its size in bytes. See
+    //   Skill::getBlock for the requirements on the block. The
+    //   default returns nullptr, meaning snapshots are not supported.
+    virtual void* getBlock(std::size_t& size) {
+        size = 0;
+        return nullptr;
+    }
 };
 
 #endif
@@ -0,0 +1,63 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+
+#include <cstdint>
+
+// A small, fast pseudo-random generator (xoshiro256**) with 32 bytes
+//   of state. Generators built from the same seed and different
+//   streams produce independent sequences, so that every search thread
+//   can draw from its own. It meets the requirements of a uniform
+//   random bit generator, so it may also be passed to the
+//   distributions of <random>.
+class Rng final {
+
+    private:
+        std::uint64_t s[4];
+
+        static std::uint64_t rotl(std::uint64_t x, int k) {return (x << k) | (x >> (64 - k));}
+
+        static std::uint64_t splitMix(std::uint64_t& x) {
+            std::uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+    public:
+        using result_type = std::uint64_t;
+
+        explicit Rng(std::uint64_t seed = 0, std::uint64_t stream = 0) {this->seed(seed, stream);}
+
+        // Restart the generator at the beginning of the given stream
+        //   of the given seed
+        void seed(std::uint64_t seed, std::uint64_t stream = 0) {
+            std::uint64_t x = seed ^ splitMix(stream);
+            for (int i = 0; i < 4; i++) s[i] = splitMix(x);
+        }
+
+        static constexpr result_type min() {return 0;}
+        static constexpr result_type max() {return ~static_cast<result_type>(0);}
+
+        result_type operator()() {
+            std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+            std::uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+            return result;
+        }
+
+        // Return an integer from low to high inclusive, uniformly at
+        //   random up to a bias of (high - low + 1) / 2^32, which is
+        //   negligible for small ranges (see Lemire, "Fast Random
+        //   Integer Generation in an Interval")
+        int uniform(int low, int high) {
+            std::uint64_t range = static_cast<std::uint64_t>(high - low) + 1;
+            return low + static_cast<int>(((*this)() >> 32) * range >> 32);
+        }
+};
+
+#endif
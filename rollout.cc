@@ -0,0 +1,32 @@
+#include <vector>
+
+#include "rng.h"
+#include "skill.h"
+#include "state.h"
+#include "rollout.h"
+
+RolloutPolicy::~RolloutPolicy() {}
+
+int GreedyRollout::choose(const State& state, const std::vector<int>& availableSkills, Rng& rng) const {
+    thread_local std::vector<DamageOutcome> outcomes;
+    int best = availableSkills[0];
+    double bestValue = -1;
+    for (int index : availableSkills) {
+        double damage = 0;
+        if (state.getDamageDistribution(index, outcomes)) {
+            for (const DamageOutcome& outcome : outcomes) damage += outcome.damage * outcome.probability;
+        } else {
+            damage = state.getDamage(index, rng);
+        }
+        double value = damage / state.getCastTime(index);
+        if (value > bestValue) {
+            best = index;
+            bestValue = value;
+        }
+    }
+    return best;
+}
+
+int RandomRollout::choose(const State& state, const std::vector<int>& availableSkills, Rng& rng) const {
+    return availableSkills[rng.uniform(0, availableSkills.size() - 1)];
+}
@@ -0,0 +1,42 @@
+#ifndef _ROLLOUT_H_
+#define _ROLLOUT_H_
+
+#include <vector>
+
+#include "rng.h"
+#include "state.h"
+
+// Chooses the skills used by rollouts, which play on from every node
+//   added to the tree to estimate its value (see
+//   SearchOptions::rollouts). Subclass it to supply a policy of your
+//   own. One policy is shared by every thread of a search, so choose()
+//   may be called concurrently and must not modify the policy.
+class RolloutPolicy {
+    public:
+        virtual ~RolloutPolicy();
+
+        // Return the index of the skill to use in the given state,
+        //   which must be one of the indices of available skills passed
+        //   in, or -1 to wait until the state changes. The vector of
+        //   available skills is never empty. Random choices must be
+        //   drawn from the generator passed in, which belongs to the
+        //   calling thread.
+        virtual int choose(const State& state, const std::vector<int>& availableSkills, Rng& rng) const = 0;
+};
+
+// Uses the available skill with the most damage per unit of cast time,
+//   taking the expected damage of skills that declare a distribution
+//   (see Skill::getDamageDistribution) and a single roll of the others.
+//   Ties are broken in favour of the lowest index.
+class GreedyRollout final : public RolloutPolicy {
+    public:
+        int choose(const State& state, const std::vector<int>& availableSkills, Rng& rng) const override;
+};
+
+// Uses an available skill chosen uniformly at random.
+class RandomRollout final : public RolloutPolicy {
+    public:
+        int choose(const State& state, const std::vector<int>& availableSkills, Rng& rng) const override;
+};
+
+#endif
@@ -1,40 +1,35 @@
+#include <limits>
 #include <vector>
-#include <unordered_map>
 
+#include "arena.h"
 #include "skill.h"
 
+Skill::Skill() {}
+
 Skill::~Skill() {}
 
-void Skill::notifyObservers() {
-    for (Skill* skill : observers) {
-        skill->notify(this);
-    }
+void* Skill::getBlock(std::size_t& size) {
+    size = 0;
+    return nullptr;
 }
 
-void Skill::setResources(Resources* resources) {
-    this->resources = resources;
+bool Skill::getDamageDistribution(std::vector<DamageOutcome>& outcomes) const {
+    outcomes.clear();
+    return false;
 }
 
-void Skill::addObserver(Skill* skill) {
-    observers.emplace_back(skill);
+bool Skill::getDamageBound(double& damage, double& rate) const {
+    std::vector<DamageOutcome> outcomes;
+    if (!getDamageDistribution(outcomes)) return false;
+    damage = 0;
+    for (const DamageOutcome& outcome : outcomes) damage += outcome.damage * outcome.probability;
+    int castTime = getCastTime();
+    rate = castTime > 0 ? damage / castTime : std::numeric_limits<double>::infinity();
+    return true;
 }
 
-void Skill::use() {
-    if (!isReady()) {throw std::terminate;}
-    useSkill();
-    notifyObservers();
-    notifyResources();
+void Skill::setResources(Resources* resources) {
+    this->resources = resources;
 }
 
-Skill* Skill::deepCopy(std::unordered_map<Skill*, Skill*>& copied) {
-    if (copied.find(this) == copied.end()) {
-        Skill* newSkill = copy();
-        copied[this] = newSkill;
-        for (Skill* ob : observers) {
-            newSkill->addObserver(ob->deepCopy(copied));
-        }
-        return newSkill;
-    } else {
-        return copied[this];
-    }
-}
+int Skill::getId() const {return id;}
@@ -1,51 +1,47 @@
 #ifndef _SKILL_H_
 #define _SKILL_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
-#include <unordered_map>
+
+#include "arena.h"
+#include "rng.h"
 
 struct Resources;
 
-class Skill {
+// One possible outcome of a cast: the damage it causes and the
+//   probability of that damage
+struct DamageOutcome {
+    int damage;
+    double probability;
+};
+
+// Skills are used and copied through the State holding them, which
+//   also records which skills observe which (see State::setObservers).
+class Skill : public ArenaAllocated {
+
+    friend class State;
 
     private:
-        std::vector<Skill*> observers;
-        void notifyObservers();
+        int id = -1;
 
     protected:
         Resources* resources;
 
     public:
 
+        // Skills constructed while an arena is current (see arena.h)
+        //   are allocated in that arena.
+        Skill();
+
         // Set the resources of the skill
         void setResources(Resources* resources);
 
-        // Set the given skill as an observer for the skill that
-        //   this method is called on. The notify() method of the
-        //   observer will be called if this skill is used.
-        void addObserver(Skill* skill);
-
-        // Use the current skill. The skill must be ready (i.e.
-        //   the return value of isReady() must be true), otherwise
-        //   the process will immediately terminate. This is a
-        //   template method that does the following operations:
-        //   useSkill() is called on this object, then every skill
-        //   that is set as an observer of this skill will have
-        //   its notify() method called, with the used skill passed
-        //   as the parameter, then notifyResources() is called on
-        //   this object.
-        void use();
-
-        // Return a pointer to a deep copy of the current Skill
-        //   object. The copy will have all of its observers set
-        //   in a new memory location, either newly allocated
-        //   or defined in the map passed in, but will not have
-        //   its resources set. The map passed in will be modified
-        //   so that it maps the memory locations of the current
-        //   skill object and its observers to the memory locations
-        //   of the new skill object and its new observers.
-        Skill* deepCopy(std::unordered_map<Skill*, Skill*>& copied);
+        // Return the index of the skill in the State holding it (see
+        //   State::getSkill), which is the same in every copy of the
+        //   State, or -1 if it is not held by one.
+        int getId() const;
 
     ///////////////////////////////////////////////////////////////
     // VIRTUAL METHODS FOR SUBCLASSING
@@ -53,22 +49,23 @@ class Skill {
     private: 
 
         // Called when a skill that the current skill is observing
-        //   is used. Use this method to modify any internal fields.
-        virtual void notify(Skill* from) = 0;
+        //   is used, with the ID of that skill (see getId). Use this
+        //   method to modify any internal fields.
+        virtual void notify(int from) = 0;
 
-        // Called when use() is called on this skill. Use this
-        //   method to modify the fields of the resources object.
+        // Called when this skill is used (see State::useSkill). Use
+        //   this method to modify the fields of the resources object.
         virtual void notifyResources() = 0;
 
-        // Called when use() is called on this skill. Use this
-        //   method to modify any internal fields.
+        // Called when this skill is used (see State::useSkill). Use
+        //   this method to modify any internal fields.
         virtual void useSkill() = 0;
 
         // Return a pointer to an object of the same class that is
         //   an exact deep copy of the object it is called on. The
         //   object must only set fields defined directly in the
         //   subclass; that is, the object must not set its own
-        //   observers or its own resources.
+        //   resources.
         virtual Skill* copy() const = 0;
 
     public:
@@ -91,9 +88,12 @@ class Skill {
 
         // Return the damage that a cast of this skill would cause.
         //   This value does not need to be deterministic given the
-        //   the current internal state. If the skill is not ready
-        //   to cast, this value is unspecified.
-        virtual int getDamage() const = 0;
+        //   the current internal state, but any randomness must be
+        //   drawn from the generator passed in, which belongs to the
+        //   calling search thread, so that searches can be reproduced
+        //   from their seed. If the skill is not ready to cast, this
+        //   value is unspecified.
+        virtual int getDamage(Rng& rng) const = 0;
 
         // Return the time that this skill would take to finish
         //   execution (also known as the time of its animation lock).
@@ -107,6 +107,53 @@ class Skill {
         //   object. This representation will be used to print
         //   the optimal rotations.
         virtual std::string toString() const = 0;
+
+        // Return a hash of the internal fields of the current Skill
+        //   object, excluding its observers and resources. Skills
+        //   for which equals() returns true must have equal hashes.
+        virtual std::size_t hash() const = 0;
+
+        // Return true if the internal fields of the current Skill
+        //   object are identical to those of the skill passed in, so
+        //   that the two skills would behave identically from now
+        //   on. The skill passed in is always of the same class as
+        //   the current one, and belongs to a copy of the same State.
+        virtual bool equals(const Skill* other) const = 0;
+
+        // OPTIONAL: Return a pointer to a single block of plain data
+        //   (e.g. a struct member) holding every internal field of
+        //   the skill that can change after construction, and set
+        //   size to its size in bytes. A State whose skills and
+        //   resources all provide a block can be stored as a flat
+        //   snapshot of their blocks, copied with a single memcpy.
+        //   The block must not contain pointers or padding, and two
+        //   skills behaving identically must have identical blocks,
+        //   since snapshots are compared byte by byte. A skill with
+        //   no such fields may return any non-null pointer and a size
+        //   of 0. The default returns nullptr, meaning snapshots are
+        //   not supported.
+        virtual void* getBlock(std::size_t& size);
+
+        // OPTIONAL: Fill the vector passed in with every damage that
+        //   getDamage() could return in the current state, each with
+        //   the probability of it being returned, and return true. The
+        //   probabilities must add up to 1. A skill must either always
+        //   or never provide a distribution. If the skill is not ready
+        //   to cast, the outcomes are unspecified. The default returns
+        //   false, meaning the damage can only be sampled.
+        virtual bool getDamageDistribution(std::vector<DamageOutcome>& outcomes) const;
+
+        // OPTIONAL: Set damage to the most expected damage a cast of
+        //   this skill can deal in any state, and rate to the most
+        //   expected damage per millisecond of cast time, and return
+        //   true. The exact solver relies on these bounds to cut off
+        //   branches, so they must hold in every state, such as when
+        //   a buff changes the damage of the skill. The default takes
+        //   them from the distribution and cast time in the current
+        //   state, which is right for skills whose damage and cast
+        //   time never change, and returns false if the skill has no
+        //   distribution.
+        virtual bool getDamageBound(double& damage, double& rate) const;
 };
 
 #endif
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rng.h"
+#include "skill.h"
+#include "state.h"
+#include "rollout.h"
+#include "solver.h"
+
+namespace {
+
+    // What is known of the most damage that can be dealt from a state
+    //   at an elapsed time: exactly value if exact, otherwise at most
+    //   value, along with the skill (or -1 for waiting) reaching it
+    struct Entry {
+        double value;
+        bool exact;
+        int action;
+    };
+
+    // The pairs of state and elapsed time solved so far. States are
+    //   kept as snapshots if they support them, otherwise as copies.
+    //   The memo is split into shards with their own locks, like the
+    //   transposition table of the search, so that threads rarely
+    //   contend.
+    class Memo final {
+        private:
+            static constexpr int numShards = 64;
+
+            struct Item {
+                int elapsed;
+                std::string snapshot;
+                std::unique_ptr<State> state;
+                Entry entry;
+            };
+
+            struct Shard {
+                std::mutex mutex;
+                std::unordered_multimap<std::size_t, Item> items;
+            };
+            Shard shards[numShards];
+
+            bool flat;
+
+            std::size_t key(const State& state, const std::string& snapshot, int elapsed) const {
+                std::size_t h = flat ? std::hash<std::string>{}(snapshot) : state.hash();
+                return h ^ (static_cast<std::size_t>(elapsed) * 0x9e3779b97f4a7c15ULL);
+            }
+
+            bool matches(const Item& item, const State& state, const std::string& snapshot, int elapsed) const {
+                return item.elapsed == elapsed && (flat ? item.snapshot == snapshot : item.state->equals(state));
+            }
+
+        public:
+            explicit Memo(bool flat): flat{flat} {}
+
+            // Sets entry to what is known of the given state, which
+            //   with flat states must have the given snapshot, and
+            //   returns whether anything is
+            bool find(const State& state, const std::string& snapshot, int elapsed, Entry& entry) {
+                std::size_t k = key(state, snapshot, elapsed);
+                Shard& shard = shards[k % numShards];
+                std::lock_guard<std::mutex> lock{shard.mutex};
+                auto range = shard.items.equal_range(k);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (!matches(it->second, state, snapshot, elapsed)) continue;
+                    entry = it->second.entry;
+                    return true;
+                }
+                return false;
+            }
+
+            // Records the entry, unless the exact value is already
+            //   known or the entry is a looser bound than the one known
+            void insert(const State& state, const std::string& snapshot, int elapsed, const Entry& entry) {
+                std::size_t k = key(state, snapshot, elapsed);
+                Shard& shard = shards[k % numShards];
+                std::lock_guard<std::mutex> lock{shard.mutex};
+                auto range = shard.items.equal_range(k);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (!matches(it->second, state, snapshot, elapsed)) continue;
+                    Entry& known = it->second.entry;
+                    if (!known.exact && (entry.exact || entry.value < known.value)) known = entry;
+                    return;
+                }
+                Item item{elapsed, flat ? snapshot : std::string{}, nullptr, entry};
+                if (!flat) item.state.reset(state.copy());
+                shard.items.emplace(k, std::move(item));
+            }
+    };
+
+    struct Action {
+        int skill;
+        int time;
+        double damage;
+    };
+
+    // Per-thread scratch space: the state at every depth of the current
+    //   branch, with flat states its snapshot, and the actions from it
+    struct Context {
+        std::deque<std::unique_ptr<State>> states;
+        std::deque<std::string> snapshots;
+        std::deque<std::vector<Action>> actions;
+        std::vector<int> availableSkills;
+        std::vector<DamageOutcome> outcomes;
+        long numStates = 0;
+        long numPruned = 0;
+    };
+
+    // A branch below the first few decisions, which the threads solve
+    //   independently
+    struct Task {
+        std::vector<int> skills;
+        double damage;
+        int elapsed;
+        std::unique_ptr<State> state;
+    };
+
+    double expectedDamage(const State& state, int index, std::vector<DamageOutcome>& outcomes) {
+        state.getDamageDistribution(index, outcomes);
+        double expected = 0;
+        for (const DamageOutcome& outcome : outcomes) expected += outcome.damage * outcome.probability;
+        return expected;
+    }
+
+    class Search final {
+        private:
+            const SolverOptions& options;
+            Memo memo;
+            bool flat;
+            std::size_t snapshotSize;
+            double maxDamage;
+            double maxDamageRate;
+
+        public:
+            Search(const State& root, const SolverOptions& options);
+
+            void listActions(const State& state, Context& context, std::vector<Action>& actions) const;
+            double solve(Context& context, int depth, int elapsed, double alpha);
+            void follow(const Task& task, std::vector<int>& skills);
+    };
+
+    Search::Search(const State& root, const SolverOptions& options): options{options}, memo{root.getSnapshotSize() > 0},
+        flat{root.getSnapshotSize() > 0}, snapshotSize{root.getSnapshotSize()}, maxDamage{0}, maxDamageRate{0} {
+        for (int i = 0; i < root.getNumSkills(); i++) {
+            double damage, rate;
+            if (!root.getDamageBound(i, damage, rate)) damage = rate = std::numeric_limits<double>::infinity();
+            maxDamage = std::max(maxDamage, damage);
+            maxDamageRate = std::max(maxDamageRate, rate);
+        }
+        if (options.maxDamageRate > 0) maxDamageRate = std::min(maxDamageRate, options.maxDamageRate);
+    }
+
+    // Fills actions with every available skill, by decreasing damage
+    //   per unit of cast time so that good rotations are found early,
+    //   then waiting
+    void Search::listActions(const State& state, Context& context, std::vector<Action>& actions) const {
+        state.getAvailableSkills(context.availableSkills);
+        actions.clear();
+        for (int index : context.availableSkills) {
+            actions.emplace_back(Action{index, state.getCastTime(index), expectedDamage(state, index, context.outcomes)});
+        }
+        std::stable_sort(actions.begin(), actions.end(), [](const Action& a, const Action& b) {
+            return a.damage * b.time > b.damage * a.time;
+        });
+        actions.emplace_back(Action{-1, state.getWaitTime(), 0});
+    }
+
+    // Returns the most damage that can be dealt from the state of the
+    //   context at the given depth, reached after the given time, if
+    //   it is more than alpha; otherwise an upper bound on it of at
+    //   most alpha. The skills that end within the fight deal at most
+    //   the highest damage rate over the time left, and the one that
+    //   ends after it at most the highest damage of a cast.
+    double Search::solve(Context& context, int depth, int elapsed, double alpha) {
+        if (elapsed >= options.fightLength) return 0;
+        double bound = maxDamageRate * (options.fightLength - elapsed) + maxDamage;
+        if (bound <= alpha) {
+            context.numPruned++;
+            return bound;
+        }
+
+        if (static_cast<int>(context.states.size()) < depth + 2) {
+            context.states.emplace_back(context.states[0]->copy());
+            context.snapshots.emplace_back(snapshotSize, '\0');
+            context.actions.emplace_back();
+        }
+        const State& state = *context.states[depth];
+        std::string& snapshot = context.snapshots[depth];
+        if (flat) state.saveSnapshot(&snapshot[0]);
+        Entry entry;
+        if (memo.find(state, snapshot, elapsed, entry) && (entry.exact || entry.value <= alpha)) return entry.value;
+        context.numStates++;
+
+        std::vector<Action>& actions = context.actions[depth];
+        listActions(state, context, actions);
+        double best = -1;
+        int bestAction = -1;
+        for (const Action& action : actions) {
+            std::unique_ptr<State>& child = context.states[depth + 1];
+            if (flat) child->loadSnapshot(snapshot.data());
+            else child.reset(state.copy());
+            child->useSkill(action.skill, action.time);
+            double childAlpha = std::max(alpha, best) - action.damage;
+            double value = action.damage + solve(context, depth + 1, elapsed + action.time, childAlpha);
+            if (value > best) {
+                best = value;
+                bestAction = action.skill;
+            }
+        }
+
+        // the snapshot is overwritten by deeper calls only at deeper
+        //   depths, so it still holds this state
+        memo.insert(state, snapshot, elapsed, Entry{best, best > alpha, bestAction});
+        return best;
+    }
+
+    // Appends the skills of the best rotation from the state of the
+    //   task, which must have been solved exactly
+    void Search::follow(const Task& task, std::vector<int>& skills) {
+        std::unique_ptr<State> state{task.state->copy()};
+        std::string snapshot(snapshotSize, '\0');
+        int elapsed = task.elapsed;
+        Entry entry;
+        while (elapsed < options.fightLength) {
+            if (flat) state->saveSnapshot(&snapshot[0]);
+            if (!memo.find(*state, snapshot, elapsed, entry) || !entry.exact) break;
+            int time = entry.action >= 0 ? state->getCastTime(entry.action) : state->getWaitTime();
+            skills.emplace_back(entry.action);
+            state->useSkill(entry.action, time);
+            elapsed += time;
+        }
+    }
+
+    // Fills skills with the rotation that always uses the skill with
+    //   the most damage per unit of cast time (see GreedyRollout), and
+    //   returns its expected damage, a lower bound on the most damage
+    //   that can be dealt
+    double greedyRotation(const State& root, int fightLength, Context& context, std::vector<int>& skills) {
+        GreedyRollout policy;
+        Rng rng;
+        std::unique_ptr<State> state{root.copy()};
+        double damage = 0;
+        skills.clear();
+        for (int elapsed = 0; elapsed < fightLength;) {
+            state->getAvailableSkills(context.availableSkills);
+            int index = context.availableSkills.empty() ? -1 : policy.choose(*state, context.availableSkills, rng);
+            int time = index >= 0 ? state->getCastTime(index) : state->getWaitTime();
+            if (index >= 0) damage += expectedDamage(*state, index, context.outcomes);
+            skills.emplace_back(index);
+            state->useSkill(index, time);
+            elapsed += time;
+        }
+        return damage;
+    }
+}
+
+bool Solver::solve(const State& state, const SolverOptions& options, Solution& solution) {
+    std::vector<DamageOutcome> outcomes;
+    for (int i = 0; i < state.getNumSkills(); i++) {
+        if (!state.getDamageDistribution(i, outcomes)) return false;
+    }
+
+    Search search{state, options};
+    int numThreads = std::max(options.numThreads, 1);
+    std::vector<Context> contexts(numThreads);
+    for (Context& context : contexts) {
+        context.states.emplace_back(state.copy());
+        context.snapshots.emplace_back(state.getSnapshotSize(), '\0');
+        context.actions.emplace_back();
+    }
+
+    // split the first few decisions into branches, until there are a
+    //   few for every thread
+    std::vector<Task> tasks;
+    tasks.emplace_back(Task{{}, 0, 0, std::unique_ptr<State>{state.copy()}});
+    std::vector<Action> actions;
+    for (int round = 0; numThreads > 1 && round < 8 && static_cast<int>(tasks.size()) < 4 * numThreads; round++) {
+        std::vector<Task> next;
+        for (Task& task : tasks) {
+            if (task.elapsed >= options.fightLength) {
+                next.emplace_back(std::move(task));
+                continue;
+            }
+            search.listActions(*task.state, contexts[0], actions);
+            for (const Action& action : actions) {
+                Task child{task.skills, task.damage + action.damage, task.elapsed + action.time,
+                           std::unique_ptr<State>{task.state->copy()}};
+                child.skills.emplace_back(action.skill);
+                child.state->useSkill(action.skill, action.time);
+                next.emplace_back(std::move(child));
+            }
+        }
+        tasks = std::move(next);
+    }
+
+    // the greedy rotation gives a first bound to beat, lowered by a
+    //   little so that a greedy rotation that is optimal is still found
+    std::vector<int> greedySkills;
+    double greedy = greedyRotation(state, options.fightLength, contexts[0], greedySkills);
+    std::atomic<double> bestDamage{greedy - 1e-6 * (greedy + 1)};
+    std::mutex bestMutex;
+    int bestTask = -1;
+    std::atomic<int> claimed{0};
+    auto work = [&](int thread) {
+        Context& context = contexts[thread];
+        for (int t = claimed.fetch_add(1); t < static_cast<int>(tasks.size()); t = claimed.fetch_add(1)) {
+            Task& task = tasks[t];
+            context.states[0].reset(task.state->copy());
+            double alpha = bestDamage.load() - task.damage;
+            double value = search.solve(context, 0, task.elapsed, alpha);
+            if (value <= alpha) continue;
+            std::lock_guard<std::mutex> lock{bestMutex};
+            if (task.damage + value > bestDamage.load() || bestTask < 0) {
+                bestDamage = task.damage + value;
+                bestTask = t;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; t++) threads.emplace_back(work, t);
+    work(0);
+    for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+
+    solution = Solution{};
+    for (const Context& context : contexts) {
+        solution.numStates += context.numStates;
+        solution.numPruned += context.numPruned;
+    }
+    if (bestTask < 0) {
+        // nothing beat the greedy rotation by more than the margin
+        //   allowed, so it is optimal
+        solution.skills = std::move(greedySkills);
+        solution.damage = greedy;
+    } else {
+        solution.skills = tasks[bestTask].skills;
+        search.follow(tasks[bestTask], solution.skills);
+        solution.damage = bestDamage;
+    }
+    for (int index : solution.skills) {
+        if (index >= 0) solution.rotation += state.toString(index) + " ";
+    }
+    solution.dps = options.fightLength > 0 ? solution.damage / options.fightLength : 0;
+    return true;
+}
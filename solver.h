@@ -0,0 +1,67 @@
+#ifndef _SOLVER_H_
+#define _SOLVER_H_
+
+#include <string>
+#include <vector>
+
+#include "state.h"
+
+struct SolverOptions {
+
+    // The time at which the fight ends, as in SearchOptions. Must be
+    //   positive.
+    int fightLength = 0;
+
+    // The number of threads searching at once, which share the
+    //   subtrees below the first few decisions between them
+    int numThreads = 1;
+
+    // A tighter upper bound on the expected damage of any skill in any
+    //   state reachable from the one solved, divided by its cast time,
+    //   or 0 for none. The branches that could not deal more damage
+    //   than the best rotation found so far, even at the highest rate
+    //   for the rest of the fight, are cut off; the rate is otherwise
+    //   the highest of the skills (see Skill::getDamageBound), and
+    //   this one is used only if it is lower.
+    double maxDamageRate = 0;
+};
+
+struct Solution {
+
+    // The indices of the skills used, in order, -1 standing for
+    //   waiting, and their string representations separated by spaces
+    //   (without the waits), as in Node::currentBestPath
+    std::vector<int> skills;
+    std::string rotation = "";
+
+    // The expected damage dealt within the fight, and the same over
+    //   the fight length
+    double damage = 0;
+    double dps = 0;
+
+    // The number of distinct pairs of state and elapsed time searched,
+    //   and of branches cut off by the bound
+    long numStates = 0;
+    long numPruned = 0;
+};
+
+// An exact solver for the same decisions as the search (see node.h):
+//   at every step, any available skill or waiting until the state
+//   changes. Since damage rolls never change the state, the rotation
+//   maximizing the expected damage within the fight can be found
+//   exactly, by a depth-first search that remembers the value of every
+//   pair of state (compared with State::equals) and elapsed time it
+//   has solved, and cuts off the branches that could not beat the
+//   best rotation found so far even at the highest rate of damage of
+//   the skills.
+struct Solver {
+
+    // Find the rotation dealing the most expected damage from the
+    //   given state within the fight length. Skills cast before the end
+    //   of the fight count in full. Every skill must declare its damage
+    //   distribution (see Skill::getDamageDistribution); otherwise
+    //   returns false, leaving the solution untouched.
+    static bool solve(const State& state, const SolverOptions& options, Solution& solution);
+};
+
+#endif
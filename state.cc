@@ -1,47 +1,117 @@
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <exception>
+#include <limits>
 #include <vector>
-#include <unordered_map>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 
+#include "arena.h"
 #include "skill.h"
 #include "resources.h"
 #include "state.h"
+#include "profile.h"
+
+StateModel::~StateModel() {}
+
+bool StateModel::getDamageBound(int index, double& damage, double& rate) const {
+    std::vector<DamageOutcome> outcomes;
+    if (!getDamageDistribution(index, outcomes)) return false;
+    damage = 0;
+    for (const DamageOutcome& outcome : outcomes) damage += outcome.damage * outcome.probability;
+    int castTime = getCastTime(index);
+    rate = castTime > 0 ? damage / castTime : std::numeric_limits<double>::infinity();
+    return true;
+}
+
+State::State(): skills{Arena::resource()}, blocks{Arena::resource()} {}
+
+State::~State() = default;
 
 void State::setSkills(std::vector<std::unique_ptr<Skill>>&& skills) {
-    this->skills = std::move(skills);
+    this->skills.clear();
+    for (auto it = skills.begin(); it != skills.end(); ++it) {
+        (*it)->id = this->skills.size();
+        this->skills.emplace_back(std::move(*it));
+    }
+    setObservers(std::vector<std::vector<int>>(this->skills.size()));
+}
+
+void State::setObservers(const std::vector<std::vector<int>>& observers) {
+    auto table = std::make_shared<Observers>();
+    table->offsets.emplace_back(0);
+    for (auto it = observers.begin(); it != observers.end(); ++it) {
+        table->indices.insert(table->indices.end(), it->begin(), it->end());
+        table->offsets.emplace_back(table->indices.size());
+    }
+    this->observers = std::move(table);
 }
 
 void State::setResources(std::unique_ptr<Resources>&& resources) {
     this->resources = std::move(resources);
 }
 
-State* State::copy(std::unordered_map<Skill*, Skill*>& copied) const {
+void State::setModel(std::unique_ptr<StateModel>&& model) {
+    this->model = std::move(model);
+}
+
+State* State::copy() const {
     State* stateCopy = new State;
+    if (model) {
+        stateCopy->model = std::unique_ptr<StateModel>{model->copy()};
+        return stateCopy;
+    }
 
     stateCopy->resources = std::unique_ptr<Resources>{resources->copy()};
     Resources* newResources = stateCopy->resources.get();
 
+    stateCopy->skills.reserve(skills.size());
     for (auto it = skills.begin(); it != skills.end(); ++it) {
-        Skill* skill = (*it).get();
-        std::unique_ptr<Skill> newSkill{skill->deepCopy(copied)};
+        std::unique_ptr<Skill> newSkill{(*it)->copy()};
+        newSkill->id = (*it)->id;
         newSkill->setResources(newResources);
         stateCopy->skills.emplace_back(std::move(newSkill));
     }
+    stateCopy->observers = observers;
+    Profile::countSkillCalls(skills.size());
 
     return stateCopy;
 }
 
+void State::getAvailableSkills(std::vector<int>& indices) const {
+    if (model) return model->getAvailableSkills(indices);
+    indices.clear();
+    for (unsigned i = 0; i < skills.size(); i++) {
+        if (skills[i]->isReady()) indices.emplace_back(i);
+    }
+    Profile::countSkillCalls(skills.size());
+}
+
+int State::getNumSkills() const {return model ? model->getNumSkills() : skills.size();}
+
+Skill* State::getSkill(int index) const {return skills[index].get();}
+
 std::vector<Skill*> State::getAvailableSkills() const {
     std::vector<Skill*> availableSkills;
     for (unsigned i = 0; i < skills.size(); i++) {
         if (skills[i]->isReady()) availableSkills.emplace_back(skills[i].get());
     }
+    Profile::countSkillCalls(skills.size());
     return availableSkills;
 }
 
 void State::useSkill(Skill* skill, int time) {
     if (skill) {
-        skill->use();
+        if (!skill->isReady()) {throw std::terminate;}
+        skill->useSkill();
+        int id = skill->id;
+        const int* first = observers->indices.data() + observers->offsets[id];
+        const int* last = observers->indices.data() + observers->offsets[id + 1];
+        for (const int* it = first; it != last; ++it) skills[*it]->notify(id);
+        skill->notifyResources();
+        Profile::countSkillCalls(3 + (last - first));
         for (auto it = skills.begin(); it != skills.end(); ++it) {
             if ((*it).get() != skill) (*it)->wait(time);
         }
@@ -51,16 +121,122 @@ void State::useSkill(Skill* skill, int time) {
         }
     }
     resources->wait(time);
+    Profile::countSkillCalls(skills.size() - (skill ? 1 : 0));
+}
+
+void State::useSkill(int index, int time) {
+    if (model) model->useSkill(index, time);
+    else useSkill(index >= 0 ? skills[index].get() : nullptr, time);
+}
+
+int State::getDamage(int index, Rng& rng) const {
+    if (model) return model->getDamage(index, rng);
+    Profile::countSkillCalls(1);
+    return skills[index]->getDamage(rng);
+}
+
+bool State::getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const {
+    if (model) return model->getDamageDistribution(index, outcomes);
+    Profile::countSkillCalls(1);
+    return skills[index]->getDamageDistribution(outcomes);
+}
+
+int State::getCastTime(int index) const {
+    if (model) return model->getCastTime(index);
+    Profile::countSkillCalls(1);
+    return skills[index]->getCastTime();
+}
+
+std::string State::toString(int index) const {return model ? model->toString(index) : skills[index]->toString();}
+
+bool State::getDamageBound(int index, double& damage, double& rate) const {
+    if (model) return model->getDamageBound(index, damage, rate);
+    return skills[index]->getDamageBound(damage, rate);
 }
 
 int State::getWaitTime() const {
+    if (model) return model->getWaitTime();
     int time = 3600000;
+    long notReady = 0;
     for (unsigned i = 0; i < skills.size(); i++) {
         Skill* skill = skills[i].get();
-        if (!skill->isReady() && skill->timeUntilReady() < time) time = skill->timeUntilReady();
+        if (skill->isReady()) continue;
+        int untilReady = skill->timeUntilReady();
+        if (untilReady < time) time = untilReady;
+        notReady++;
     }
+    Profile::countSkillCalls(skills.size() + notReady);
     Resources* r = resources.get();
     if (r->timeUntilNextUpdate() < time) time = r->timeUntilNextUpdate();
 
     return time;
 }
+
+namespace {
+    std::size_t combine(std::size_t seed, std::size_t hash) {
+        return seed ^ (hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+}
+
+std::size_t State::hash() const {
+    if (model) return model->hash();
+    std::size_t h = resources->hash();
+    for (auto it = skills.begin(); it != skills.end(); ++it) {
+        h = combine(h, (*it)->hash());
+    }
+    Profile::countSkillCalls(skills.size());
+    return h;
+}
+
+bool State::equals(const State& other) const {
+    if (model) return model->equals(*other.model);
+    if (skills.size() != other.skills.size()) return false;
+    for (unsigned i = 0; i < skills.size(); i++) {
+        Profile::countSkillCalls(1);
+        if (!skills[i]->equals(other.skills[i].get())) return false;
+    }
+    return resources->equals(other.resources.get());
+}
+
+void State::findBlocks() const {
+    blocks.clear();
+    snapshotSize = 0;
+    for (auto it = skills.begin(); it != skills.end(); ++it) {
+        Block block;
+        block.data = (*it)->getBlock(block.size);
+        if (!block.data) return;
+        blocks.emplace_back(block);
+    }
+    Block block;
+    block.data = resources->getBlock(block.size);
+    if (!block.data) return;
+    blocks.emplace_back(block);
+
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) snapshotSize += it->size;
+}
+
+std::size_t State::getSnapshotSize() const {
+    if (model) return model->getSnapshotSize();
+    if (blocks.size() != skills.size() + 1) findBlocks();
+    return snapshotSize;
+}
+
+void State::saveSnapshot(void* snapshot) const {
+    if (model) return model->saveSnapshot(snapshot);
+    if (blocks.size() != skills.size() + 1) findBlocks();
+    char* p = static_cast<char*>(snapshot);
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+        std::memcpy(p, it->data, it->size);
+        p += it->size;
+    }
+}
+
+void State::loadSnapshot(const void* snapshot) {
+    if (model) return model->loadSnapshot(snapshot);
+    if (blocks.size() != skills.size() + 1) findBlocks();
+    const char* p = static_cast<const char*>(snapshot);
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+        std::memcpy(it->data, p, it->size);
+        p += it->size;
+    }
+}
@@ -1,31 +1,98 @@
 #ifndef _STATE_H_
 #define _STATE_H_
 
+#include <cstddef>
+#include <string>
 #include <vector>
-#include <unordered_map>
 #include <memory>
+#include <memory_resource>
+
+#include "arena.h"
+#include "rng.h"
 
 class Skill;
 class Resources;
+struct DamageOutcome;
+
+// Skills and resources whose types are known at compile time, which a
+//   State can run in place of Skill and Resources objects (see
+//   static_state.h). Each method does for the whole set of skills what
+//   the State method of the same name does, with skills given by their
+//   index, so that a single virtual call covers every skill.
+class StateModel : public ArenaAllocated {
+    public:
+        virtual ~StateModel();
+        virtual StateModel* copy() const = 0;
+        virtual int getNumSkills() const = 0;
+        virtual void getAvailableSkills(std::vector<int>& indices) const = 0;
+        virtual void useSkill(int index, int time) = 0;
+        virtual int getWaitTime() const = 0;
+        virtual int getDamage(int index, Rng& rng) const = 0;
+        virtual bool getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const = 0;
+        virtual int getCastTime(int index) const = 0;
+        virtual std::string toString(int index) const = 0;
 
-class State final {
+        // The default takes the bounds from the current state, as the
+        //   default of Skill::getDamageBound does
+        virtual bool getDamageBound(int index, double& damage, double& rate) const;
+        virtual std::size_t hash() const = 0;
+        virtual bool equals(const StateModel& other) const = 0;
+        virtual std::size_t getSnapshotSize() const = 0;
+        virtual void saveSnapshot(void* snapshot) const = 0;
+        virtual void loadSnapshot(const void* snapshot) = 0;
+};
+
+class State final : public ArenaAllocated {
 
     private:
-        std::vector<std::unique_ptr<Skill>> skills;
+        std::pmr::vector<std::unique_ptr<Skill>> skills;
         std::unique_ptr<Resources> resources;
+        std::unique_ptr<StateModel> model;
+
+        // Which skills observe which, as compressed rows: the skills
+        //   observing skill i are those at indices[offsets[i]] up to
+        //   indices[offsets[i + 1]]. Built once, then shared by every
+        //   copy of the State and never modified.
+        struct Observers {
+            std::vector<int> offsets;
+            std::vector<int> indices;
+        };
+        std::shared_ptr<const Observers> observers;
+
+        // The blocks making up a snapshot, found on first use
+        struct Block {
+            void* data;
+            std::size_t size;
+        };
+        mutable std::pmr::vector<Block> blocks;
+        mutable std::size_t snapshotSize = 0;
+        void findBlocks() const;
 
     public:
 
+        // States constructed while an arena is current (see arena.h)
+        //   are allocated in that arena, and so are their copies.
+        State();
+        ~State();
+
         // Set all the skills, stealing ownership of the vector and
         //   every pointer it stores. The skills in the vector must
-        //   already have all of their observers set (if there are
-        //   any) and their resources set to the same object. This
-        //   method and the next must be called before any other
-        //   method is called, otherwise behaviour is undefined.
-        //   This method must be called only once, otherwise
-        //   behaviour is also undefined.
+        //   already have their resources set to the same object, and
+        //   each is given its index in the vector as its ID (see
+        //   Skill::getId). This method and the next must be called
+        //   before any other method is called, otherwise behaviour is
+        //   undefined. This method must be called only once,
+        //   otherwise behaviour is also undefined.
         void setSkills(std::vector<std::unique_ptr<Skill>>&& skills);
 
+        // Set which skills observe which: observers[i] holds the IDs
+        //   of the skills whose notify() method is called whenever
+        //   the skill of ID i is used, in the order they are called.
+        //   Without a call to this method no skill observes another.
+        //   It may only be called after setSkills, and before the
+        //   State is first copied or used.
+        void setObservers(const std::vector<std::vector<int>>& observers);
+
         // Set the resources of the skills, stealing ownership of
         //   the pointer passed in. The resources passed in must
         //   be the resources of every skill in the skills vector.
@@ -35,33 +102,92 @@ class State final {
         //   otherwise behaviour is also undefined.
         void setResources(std::unique_ptr<Resources>&& resources);
 
+        // Run the given model instead of Skill and Resources objects,
+        //   stealing ownership of the pointer passed in. This method
+        //   replaces the previous two, and the same rules apply to it.
+        //   The State then has no Skill objects, so getSkill and the
+        //   methods taking or returning them must not be called; the
+        //   methods taking skill indices must be used instead.
+        void setModel(std::unique_ptr<StateModel>&& model);
+
         // Return a pointer to a deep copy of the current State
         //   object. The copy will have all of its skills and
-        //   resources in a different memory location, with their
-        //   observers set to the new locations. The map passed
-        //   in will be modified so that it maps the memory
-        //   location of every old skill pointer to the new
-        //   memory location of the corresponding pointer.
-        State* copy(std::unordered_map<Skill*, Skill*>& copied) const;
+        //   resources in a different memory location, and share
+        //   the observers of the current one. The copy is placed
+        //   in the calling thread's current arena if there is one,
+        //   otherwise on the heap.
+        State* copy() const;
 
         // Get a vector of pointers pointing to the skills currently
         //   available for use.
         std::vector<Skill*> getAvailableSkills() const;
 
+        // Fill the vector passed in with the indices (as passed to
+        //   getSkill) of the skills currently available for use.
+        void getAvailableSkills(std::vector<int>& indices) const;
+
+        // Return the number of skills.
+        int getNumSkills() const;
+
+        // Return the skill at the given index, in the order the
+        //   skills were set. A skill has the same index in every
+        //   copy of the State.
+        Skill* getSkill(int index) const;
+
         // Use the indicated skill with the given cast time. The skill
         //   must either be nullptr or one of the skills returned by a
         //   call to getAvailableSkills. If the skill is nullptr, then
         //   wait(time) is called on every skill and the resources. If
-        //   the skill is not nullptr, then use() is called on that
-        //   skill, and wait(time) is called on every other skill and
-        //   the resources.
+        //   the skill is not nullptr, then useSkill() is called on that
+        //   skill, then notify() on every skill observing it, then
+        //   notifyResources() on the skill, and finally wait(time) on
+        //   every other skill and the resources. The process will
+        //   terminate if the skill is not ready.
         void useSkill(Skill* skill, int time);
 
+        // Same as above, with the skill given by its index, or -1 to
+        //   wait.
+        void useSkill(int index, int time);
+
+        // Return the result of the method of the same name of the
+        //   skill at the given index (see skill.h).
+        int getDamage(int index, Rng& rng) const;
+        bool getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const;
+        int getCastTime(int index) const;
+        std::string toString(int index) const;
+        bool getDamageBound(int index, double& damage, double& rate) const;
+
         // Get the minimum wait time until a state change. This is
         //   determined by taking the minimum of the timeUntilReady
         //   calls on the skills along with the result of the
         //   timeUntilNextUpdate call on the resources.
         int getWaitTime() const;
+
+        // Return a hash of the current State object, combining the
+        //   hashes of its skills and resources.
+        std::size_t hash() const;
+
+        // Return true if the State passed in is a copy of the same
+        //   State whose skills and resources are all equal to those
+        //   of the current one, so that the two would behave
+        //   identically from now on.
+        bool equals(const State& other) const;
+
+        // Return the size in bytes of a snapshot of the current
+        //   State object, or 0 if some skill or the resources do not
+        //   provide a block (see Skill::getBlock).
+        std::size_t getSnapshotSize() const;
+
+        // Write a snapshot of every internal field that can change
+        //   into the memory passed in, which must be at least
+        //   getSnapshotSize() bytes long.
+        void saveSnapshot(void* snapshot) const;
+
+        // Restore the internal fields of every skill and the
+        //   resources from a snapshot saved from this State or a
+        //   copy of it. Observers and resources are left untouched,
+        //   so one State can stand in for any number of snapshots.
+        void loadSnapshot(const void* snapshot);
 };
 
 #endif
@@ -0,0 +1,223 @@
+#ifndef _STATIC_STATE_H_
+#define _STATIC_STATE_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+#include "rng.h"
+#include "skill.h"
+#include "state.h"
+
+// A StateModel whose resources and skills are known at compile time,
+//   for kits whose skills are fixed, so that the simulation runs
+//   without virtual calls, dynamic_cast or observer lists: which skill
+//   reacts to which is resolved when the template is instantiated, and
+//   every call on a skill can be inlined. It is passed to
+//   State::setModel, so the search sees an ordinary State.
+//
+// The skills and resources are plain classes (see bm.cc for an
+//   example). With R the class of the resources, R must provide
+//
+//       int timeUntilNextUpdate() const;
+//       void wait(int time);
+//
+//   and every skill must provide
+//
+//       static constexpr const char* name;
+//       bool isReady(const R& resources) const;
+//       int timeUntilReady(const R& resources) const;
+//       void wait(int time);
+//       void use(R& resources);
+//       int getDamage(const R& resources, Rng& rng) const;
+//       int getCastTime(const R& resources) const;
+//
+//   which behave as the Skill and Resources methods of the same name,
+//   use() doing the work of both useSkill() and notifyResources().
+//   A skill observes another by declaring
+//
+//       void notify(const Other& from);
+//
+//   for the class Other of that skill, and may declare
+//
+//       bool getDamageDistribution(const R& resources, std::vector<DamageOutcome>& outcomes) const;
+//       bool getDamageBound(double& damage, double& rate) const;
+//
+//   the second as Skill::getDamageBound, which is otherwise taken from
+//   the current state.
+//
+//   When a skill is used, use() is called on it, then notify() on
+//   every skill observing it, then wait() on every other skill and on
+//   the resources. Every class must be default constructible into its
+//   initial state. The whole state is copied, compared and hashed as
+//   raw bytes, so the classes must be trivially copyable without
+//   padding, and two states must behave identically exactly when their
+//   bytes are equal.
+template<typename R, typename... Skills>
+class StaticState final : public StateModel {
+
+    private:
+        template<std::size_t I, typename T>
+        struct Leaf : T {};
+
+        template<typename Indices>
+        struct Storage;
+
+        template<std::size_t... I>
+        struct Storage<std::index_sequence<I...>> : Leaf<I, Skills>... {};
+
+        using Indices = std::index_sequence_for<Skills...>;
+
+        struct Fields {
+            R resources;
+            Storage<Indices> skills;
+        } f;
+
+        // skills with no fields take up no space, but are not counted
+        //   as free of padding by has_unique_object_representations
+        static constexpr std::size_t fieldBytes = sizeof(R) + (0 + ... + (std::is_empty_v<Skills> ? 0 : sizeof(Skills)));
+        static_assert(std::is_trivially_copyable_v<Fields> && std::has_unique_object_representations_v<R>
+                      && ((std::is_empty_v<Skills> || std::has_unique_object_representations_v<Skills>) && ...)
+                      && sizeof(Fields) == fieldBytes, "skills and resources must be trivially copyable without padding");
+
+        template<typename S, typename From, typename = void>
+        struct Observes : std::false_type {};
+
+        template<typename S, typename From>
+        struct Observes<S, From, std::void_t<decltype(std::declval<S&>().notify(std::declval<const From&>()))>>
+            : std::true_type {};
+
+        template<typename S, typename = void>
+        struct HasDistribution : std::false_type {};
+
+        template<typename S>
+        struct HasDistribution<S, std::void_t<decltype(std::declval<const S&>().getDamageDistribution(
+            std::declval<const R&>(), std::declval<std::vector<DamageOutcome>&>()))>> : std::true_type {};
+
+        template<typename S, typename = void>
+        struct HasBound : std::false_type {};
+
+        template<typename S>
+        struct HasBound<S, std::void_t<decltype(std::declval<const S&>().getDamageBound(
+            std::declval<double&>(), std::declval<double&>()))>> : std::true_type {};
+
+        template<std::size_t I>
+        using SkillAt = std::tuple_element_t<I, std::tuple<Skills...>>;
+
+        template<std::size_t I>
+        SkillAt<I>& skill() {return static_cast<Leaf<I, SkillAt<I>>&>(f.skills);}
+
+        template<std::size_t I>
+        const SkillAt<I>& skill() const {return static_cast<const Leaf<I, SkillAt<I>>&>(f.skills);}
+
+        // Calls fn(std::integral_constant<std::size_t, I>{}) for every
+        //   skill index I, in order
+        template<typename Fn, std::size_t... I>
+        static void forEach(Fn&& fn, std::index_sequence<I...>) {
+            (fn(std::integral_constant<std::size_t, I>{}), ...);
+        }
+
+        // Returns fn(std::integral_constant<std::size_t, I>{}) for the
+        //   skill index I equal to the given one
+        template<typename Result, typename Fn, std::size_t... I>
+        static Result dispatch(int index, Fn&& fn, std::index_sequence<I...>) {
+            Result result{};
+            ((static_cast<int>(I) == index ? (result = fn(std::integral_constant<std::size_t, I>{}), true) : false) || ...);
+            return result;
+        }
+
+    public:
+        StaticState* copy() const override {return new StaticState{*this};}
+
+        int getNumSkills() const override {return sizeof...(Skills);}
+
+        void getAvailableSkills(std::vector<int>& indices) const override {
+            indices.clear();
+            forEach([&](auto i) {
+                if (skill<i>().isReady(f.resources)) indices.emplace_back(i);
+            }, Indices{});
+        }
+
+        void useSkill(int index, int time) override {
+            forEach([&](auto used) {
+                if (static_cast<int>(used) != index) return;
+                skill<used>().use(f.resources);
+                forEach([&](auto i) {
+                    if constexpr (i != used && Observes<SkillAt<i>, SkillAt<used>>::value) {
+                        skill<i>().notify(skill<used>());
+                    }
+                }, Indices{});
+            }, Indices{});
+            forEach([&](auto i) {
+                if (static_cast<int>(i) != index) skill<i>().wait(time);
+            }, Indices{});
+            f.resources.wait(time);
+        }
+
+        int getWaitTime() const override {
+            int time = 3600000;
+            forEach([&](auto i) {
+                if (skill<i>().isReady(f.resources)) return;
+                int untilReady = skill<i>().timeUntilReady(f.resources);
+                if (untilReady < time) time = untilReady;
+            }, Indices{});
+            int untilUpdate = f.resources.timeUntilNextUpdate();
+            return untilUpdate < time ? untilUpdate : time;
+        }
+
+        int getDamage(int index, Rng& rng) const override {
+            return dispatch<int>(index, [&](auto i) {return skill<i>().getDamage(f.resources, rng);}, Indices{});
+        }
+
+        bool getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const override {
+            outcomes.clear();
+            return dispatch<bool>(index, [&](auto i) {
+                if constexpr (HasDistribution<SkillAt<i>>::value) {
+                    return skill<i>().getDamageDistribution(f.resources, outcomes);
+                } else {
+                    return false;
+                }
+            }, Indices{});
+        }
+
+        int getCastTime(int index) const override {
+            return dispatch<int>(index, [&](auto i) {return skill<i>().getCastTime(f.resources);}, Indices{});
+        }
+
+        bool getDamageBound(int index, double& damage, double& rate) const override {
+            return dispatch<bool>(index, [&](auto i) {
+                if constexpr (HasBound<SkillAt<i>>::value) {
+                    return skill<i>().getDamageBound(damage, rate);
+                } else {
+                    return StateModel::getDamageBound(index, damage, rate);
+                }
+            }, Indices{});
+        }
+
+        std::string toString(int index) const override {
+            return dispatch<std::string>(index, [](auto i) {return std::string{SkillAt<i>::name};}, Indices{});
+        }
+
+        std::size_t hash() const override {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(&f);
+            std::size_t h = 0xcbf29ce484222325ULL;
+            for (std::size_t i = 0; i < sizeof(f); i++) h = (h ^ p[i]) * 0x100000001b3ULL;
+            return h;
+        }
+
+        bool equals(const StateModel& other) const override {
+            return std::memcmp(&f, &static_cast<const StaticState&>(other).f, sizeof(f)) == 0;
+        }
+
+        std::size_t getSnapshotSize() const override {return sizeof(f);}
+
+        void saveSnapshot(void* snapshot) const override {std::memcpy(snapshot, &f, sizeof(f));}
+
+        void loadSnapshot(const void* snapshot) override {std::memcpy(&f, snapshot, sizeof(f));}
+};
+
+#endif
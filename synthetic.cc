@@ -0,0 +1,214 @@
+#include <string>
+#include <vector>
+#include <random>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "rng.h"
+#include "skill.h"
+#include "resources.h"
+#include "state.h"
+#include "synthetic.h"
+
+namespace {
+
+    // Return a number from 1 to 5 uniformly at random
+    int roll(Rng& rng) {return rng.uniform(1, 5);}
+}
+
+// A synthetic kit: every skill has a cast time, a cooldown measured
+//   from the end of its cast, a non-crit and a crit damage with a
+//   crit chance between 20% and 80%, and an energy cost. Energy
+//   starts at 100 and regenerates 5 units every 500 milliseconds when
+//   it is not at its maximum. A skill may observe a few others, in
+//   which case every cast of one of them reduces its cooldown by a
+//   fixed amount. Skill 0 is always a filler with no cooldown and no
+//   cost, so that some skill is available in every state.
+
+class SyntheticSkill;
+
+struct SyntheticResources : public Resources {
+
+    int getEnergy() const {return f.energy;}
+
+    // Return the time until the energy reaches the given amount
+    int timeUntilEnergy(int energy) const {
+        if (f.energy >= energy) return 0;
+        return (energy - f.energy + 4) / 5 * 500 - f.regenOffset;
+    }
+
+    void spend(int energy) {f.energy -= energy;}
+
+    int timeUntilNextUpdate() const override {return f.energy == 100 ? 3600000 : 500 - f.regenOffset;}
+
+    void wait(int time) override {
+        if (f.energy == 100) return;
+        f.regenOffset += time;
+        f.energy += f.regenOffset / 500 * 5;
+        f.regenOffset %= 500;
+        if (f.energy >= 100) {
+            f.energy = 100;
+            f.regenOffset = 0;
+        }
+    }
+
+    Resources* copy() const override {
+        SyntheticResources* newResources = new SyntheticResources();
+        newResources->f = f;
+        return newResources;
+    }
+
+    std::size_t hash() const override {return f.energy * 500 + f.regenOffset;}
+    bool equals(const Resources* other) const override {
+        const Fields& g = static_cast<const SyntheticResources*>(other)->f;
+        return f.energy == g.energy && f.regenOffset == g.regenOffset;
+    }
+    void* getBlock(std::size_t& size) override {size = sizeof(f); return &f;}
+
+    private:
+        struct Fields {
+            int energy = 100;
+            int regenOffset = 0;
+        } f;
+};
+
+class SyntheticSkill : public Skill {
+
+    public:
+        // The parameters of a skill, which never change
+        struct Params {
+            int index;
+            int castTime;
+            int cooldown;
+            int damage;
+            int critDamage;
+            int critRoll;
+            int cost;
+            int reduction;
+        };
+
+    private:
+        const Params* params;
+        int cd = 0;
+
+        SyntheticResources* energy() const {return static_cast<SyntheticResources*>(resources);}
+
+        void notify(int from) override {cd = cd < params->reduction ? 0 : cd - params->reduction;}
+        void notifyResources() override {energy()->spend(params->cost);}
+        void useSkill() override {cd = params->cooldown;}
+        Skill* copy() const override {SyntheticSkill* s = new SyntheticSkill{params}; s->cd = cd; return s;}
+
+    public:
+        explicit SyntheticSkill(const Params* params): params{params} {}
+
+        bool isReady() const override {return cd == 0 && energy()->getEnergy() >= params->cost;}
+        int timeUntilReady() const override {
+            int energyTime = energy()->timeUntilEnergy(params->cost);
+            return cd > energyTime ? cd : energyTime;
+        }
+        void wait(int time) override {cd = cd < time ? 0 : cd - time;}
+        int getDamage(Rng& rng) const override {return roll(rng) >= params->critRoll ? params->critDamage : params->damage;}
+        bool getDamageDistribution(std::vector<DamageOutcome>& outcomes) const override {
+            double critChance = (6 - params->critRoll) / 5.0;
+            outcomes.assign({DamageOutcome{params->damage, 1 - critChance}, DamageOutcome{params->critDamage, critChance}});
+            return true;
+        }
+        int getCastTime() const override {return params->castTime;}
+        std::string toString() const override {return "S" + std::to_string(params->index);}
+        std::size_t hash() const override {return cd;}
+        bool equals(const Skill* other) const override {return cd == static_cast<const SyntheticSkill*>(other)->cd;}
+        void* getBlock(std::size_t& size) override {size = sizeof(cd); return &cd;}
+};
+
+namespace {
+
+    // Generate the parameters of the skills of a kit, and which skills
+    //   observe which (see State::setObservers)
+    void generate(int numSkills, unsigned seed, std::vector<SyntheticSkill::Params>& params,
+                  std::vector<std::vector<int>>& observers) {
+        std::mt19937 generator{seed};
+        auto uniform = [&](int low, int high) {return std::uniform_int_distribution<int>{low, high}(generator);};
+
+        params.resize(numSkills);
+        for (int i = 0; i < numSkills; i++) {
+            SyntheticSkill::Params& p = params[i];
+            p.index = i;
+            p.castTime = uniform(5, 20) * 50;
+            p.cooldown = i == 0 ? 0 : uniform(1, 60) * 500;
+            p.damage = i == 0 ? uniform(2, 6) * 10 : p.castTime / 10 + p.cooldown / 100 * uniform(5, 15) / 10;
+            p.critDamage = p.damage * uniform(15, 20) / 10;
+            p.critRoll = uniform(2, 5);
+            p.cost = i == 0 ? 0 : uniform(0, 6) * 5;
+            p.reduction = uniform(1, 4) * 500;
+        }
+
+        observers.assign(numSkills, {});
+        for (int i = 1; i < numSkills; i++) {
+            int numObserved = uniform(0, 2);
+            for (int j = 0; j < numObserved; j++) {
+                int observed = uniform(0, numSkills - 1);
+                if (observed != i) observers[observed].emplace_back(i);
+            }
+        }
+    }
+}
+
+std::unique_ptr<State> Synthetic::makeState(int numSkills, unsigned seed) {
+
+    // the parameters are shared by every copy of the skills, and by
+    //   every kit generated from the same arguments, so that copies
+    //   need not count references to them. They are kept, one set per
+    //   pair of arguments, for the lifetime of the program.
+    static std::mutex mutex;
+    static std::map<std::pair<int, unsigned>, std::unique_ptr<const std::vector<SyntheticSkill::Params>>> kits;
+    std::vector<SyntheticSkill::Params> generated;
+    std::vector<std::vector<int>> observers;
+    generate(numSkills, seed, generated, observers);
+    const std::vector<SyntheticSkill::Params>* kit;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto& entry = kits[{numSkills, seed}];
+        if (!entry) entry = std::make_unique<const std::vector<SyntheticSkill::Params>>(std::move(generated));
+        kit = entry.get();
+    }
+    const std::vector<SyntheticSkill::Params>& params = *kit;
+
+    std::vector<std::unique_ptr<Skill>> skills;
+    std::unique_ptr<Resources> resources = std::make_unique<SyntheticResources>();
+    for (int i = 0; i < numSkills; i++) {
+        skills.emplace_back(std::make_unique<SyntheticSkill>(&params[i]));
+        skills.back()->setResources(resources.get());
+    }
+
+    std::unique_ptr<State> state = std::make_unique<State>();
+    state->setSkills(std::move(skills));
+    state->setResources(std::move(resources));
+    state->setObservers(observers);
+    return state;
+}
+
+// A crit is a roll of critRoll or more from 1 to 5, so the two damages
+//   are given the weights of the rolls dealing them
+std::string Synthetic::describe(int numSkills, unsigned seed) {
+    std::vector<SyntheticSkill::Params> params;
+    std::vector<std::vector<int>> observers;
+    generate(numSkills, seed, params, observers);
+
+    std::string kit = "resource energy start=100 max=100 regen=5 every=500\n";
+    for (const SyntheticSkill::Params& p : params) {
+        kit += "skill S" + std::to_string(p.index) + " cast=" + std::to_string(p.castTime) +
+            " cooldown=" + std::to_string(p.cooldown) + " damage=" + std::to_string(p.damage) + ":" +
+            std::to_string(p.critRoll - 1) + "," + std::to_string(p.critDamage) + ":" + std::to_string(6 - p.critRoll);
+        if (p.cost) kit += " cost=energy:" + std::to_string(p.cost);
+        std::string reductions;
+        for (int observer : observers[p.index]) {
+            reductions += (reductions.empty() ? "" : ",") + ("S" + std::to_string(observer)) + ":" +
+                std::to_string(params[observer].reduction);
+        }
+        if (!reductions.empty()) kit += " reduces=" + reductions;
+        kit += "\n";
+    }
+    return kit;
+}
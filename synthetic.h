@@ -0,0 +1,23 @@
+#ifndef _SYNTHETIC_H_
+#define _SYNTHETIC_H_
+
+#include <memory>
+#include <string>
+
+#include "state.h"
+
+// Randomly generated kits of any size, for measuring how the search
+//   scales with the number of skills (see synthetic.cc)
+struct Synthetic {
+
+    // Return the initial state of a kit of the given number of skills,
+    //   generated from the given seed. The same number of skills and
+    //   seed always give the same kit.
+    static std::unique_ptr<State> makeState(int numSkills, unsigned seed);
+
+    // Return the same kit as a kit file (see table_kit.h), to run it
+    //   with the state models of TableKit
+    static std::string describe(int numSkills, unsigned seed);
+};
+
+#endif
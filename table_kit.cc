@@ -0,0 +1,1070 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "rng.h"
+#include "skill.h"
+#include "state.h"
+#include "table_kit.h"
+
+namespace {
+
+    struct Outcome {
+        int damage;
+        int weight;
+    };
+
+    // Something a variant does to the resource, buff or skill of the
+    //   given index: the amount spent, the time the buff is applied
+    //   for, or the time taken off the cooldown
+    struct Effect {
+        int target;
+        int amount;
+    };
+
+    // A variant of a skill as read from the file
+    struct Variant {
+        int buff = -1;
+        int castTime = 0;
+        int cooldown = -1;
+        bool ignoreCooldown = false;
+        int totalWeight = 0;
+        std::vector<Outcome> outcomes;
+        std::vector<Effect> costs;
+        std::vector<Effect> buffs;
+        std::vector<Effect> reductions;
+        std::vector<int> ticks;
+    };
+
+    struct Resource {
+        int start = 0;
+        int max = 1 << 30;
+        int regen = 0;
+        int every = 1000;
+    };
+
+    struct Ticks {
+        int resource = -1;
+        int amount = 0;
+        int every = 1000;
+        int duration = 0;
+    };
+
+    // A variant of a skill as laid out in the table. Its buff, and the
+    //   targets of its effects, are given by their place in the array
+    //   of the state. Its effects are ranges of the effects of the
+    //   table: its costs from costs up to reductions, then its
+    //   reductions, its buffs, and its ticks (each with the number of
+    //   ticks to come) up to end. Its outcomes are a range of the
+    //   outcomes of the table.
+    struct Row {
+        int buff;
+        int castTime;
+        int cooldown;
+        bool ignoreCooldown;
+        int totalWeight;
+        int costs, reductions, buffs, ticks, end;
+        int outcomes, outcomesEnd;
+        int next;
+    };
+
+    // The kit, shared by every copy of the state. The first variant of
+    //   skill i is row i, and every row gives the next variant of its
+    //   skill, if any, so that most skills are found in one step. The
+    //   state is one array holding the cooldowns of the skills, the
+    //   amounts of the resources, their regen timers, the time left on
+    //   the buffs, and for each ticks the time until the next tick and
+    //   the number of ticks left, from the offsets below.
+    struct Table {
+        std::vector<std::string> names;
+        std::vector<Row> rows;
+        std::vector<Effect> effects;
+        std::vector<Outcome> outcomes;
+        std::vector<Resource> resources;
+        std::vector<Ticks> ticks;
+        int numBuffs = 0;
+
+        int amountOffset = 0;
+        int timerOffset = 0;
+        int buffOffset = 0;
+        int ticksOffset = 0;
+        int size = 0;
+
+        // The skills whose readiness depends on each slot of the array,
+        //   as compressed rows: the skills reading slot s are those at
+        //   readers[readerOffsets[s]] up to readers[readerOffsets[s + 1]].
+        //   A skill reads its cooldown and the buffs its variants depend
+        //   on. The costs of the variants on each resource are listed
+        //   apart, as compressed rows of the skill and the amount sorted
+        //   by amount, since a skill only needs looking at again when the
+        //   amount of the resource goes past one of its costs.
+        std::vector<int> readerOffsets;
+        std::vector<int> readers;
+        std::vector<int> costOffsets;
+        std::vector<Effect> costs;
+
+        void add(int index, const Variant& variant);
+        void link();
+        void bound(int index, double& damage, double& rate) const;
+    };
+
+    // Lays out the variant of the skill of the given index, after its
+    //   previous variants. The offsets must be set.
+    void Table::add(int index, const Variant& variant) {
+        Row row{variant.buff < 0 ? -1 : buffOffset + variant.buff, variant.castTime, variant.cooldown,
+                variant.ignoreCooldown, variant.totalWeight, 0, 0, 0, 0, 0, 0, 0, -1};
+        row.costs = effects.size();
+        for (const Effect& cost : variant.costs) effects.emplace_back(Effect{amountOffset + cost.target, cost.amount});
+        row.reductions = effects.size();
+        effects.insert(effects.end(), variant.reductions.begin(), variant.reductions.end());
+        row.buffs = effects.size();
+        for (const Effect& buff : variant.buffs) effects.emplace_back(Effect{buffOffset + buff.target, buff.amount});
+        row.ticks = effects.size();
+        for (int k : variant.ticks) {
+            effects.emplace_back(Effect{ticksOffset + 2 * k, ticks[k].duration / ticks[k].every + 1});
+        }
+        row.end = effects.size();
+        row.outcomes = outcomes.size();
+        outcomes.insert(outcomes.end(), variant.outcomes.begin(), variant.outcomes.end());
+        row.outcomesEnd = outcomes.size();
+
+        if (rows[index].castTime == 0) {
+            rows[index] = row;
+            return;
+        }
+        int last = index;
+        while (rows[last].next >= 0) last = rows[last].next;
+        rows[last].next = rows.size();
+        rows.emplace_back(row);
+    }
+
+    void Table::link() {
+        std::vector<std::vector<int>> read(size);
+        std::vector<std::vector<Effect>> cost(resources.size());
+        for (std::size_t i = 0; i < names.size(); i++) {
+            read[i].emplace_back(i);
+            for (int r = i; r >= 0; r = rows[r].next) {
+                int buff = rows[r].buff;
+                if (buff >= 0 && (read[buff].empty() || read[buff].back() != static_cast<int>(i))) {
+                    read[buff].emplace_back(i);
+                }
+                for (int e = rows[r].costs; e < rows[r].reductions; e++) {
+                    cost[effects[e].target - amountOffset].emplace_back(Effect{static_cast<int>(i), effects[e].amount});
+                }
+            }
+        }
+        readerOffsets.assign(1, 0);
+        for (const std::vector<int>& skills : read) {
+            readers.insert(readers.end(), skills.begin(), skills.end());
+            readerOffsets.emplace_back(readers.size());
+        }
+        costOffsets.assign(1, 0);
+        for (std::vector<Effect>& resourceCosts : cost) {
+            std::sort(resourceCosts.begin(), resourceCosts.end(), [](const Effect& a, const Effect& b) {
+                return a.amount < b.amount;
+            });
+            costs.insert(costs.end(), resourceCosts.begin(), resourceCosts.end());
+            costOffsets.emplace_back(costs.size());
+        }
+    }
+
+    // The bounds of Skill::getDamageBound for the skill of the given
+    //   index, over all of its variants
+    void Table::bound(int index, double& damage, double& rate) const {
+        damage = 0;
+        rate = 0;
+        for (int r = index; r >= 0; r = rows[r].next) {
+            const Row& row = rows[r];
+            double expected = 0;
+            for (int i = row.outcomes; i < row.outcomesEnd; i++) expected += outcomes[i].damage * outcomes[i].weight;
+            expected /= row.totalWeight;
+            damage = std::max(damage, expected);
+            rate = std::max(rate, expected / row.castTime);
+        }
+    }
+
+    class TableState final : public StateModel {
+
+        private:
+            std::shared_ptr<const Table> table;
+            std::pmr::vector<int> values;
+
+            // called for every skill at every step, so always inlined
+            __attribute__((always_inline)) const Row* variant(const Row* rows, const int* v, int index) const;
+            __attribute__((always_inline)) int timeUntilReady(const Row* rows, const int* v, int index) const;
+            void gain(int* v, int resource, int amount) const;
+
+        public:
+            explicit TableState(const std::shared_ptr<const Table>& table);
+            TableState(const TableState& other);
+
+            TableState* copy() const override {return new TableState{*this};}
+            int getNumSkills() const override {return table->names.size();}
+            void getAvailableSkills(std::vector<int>& indices) const override;
+            void useSkill(int index, int time) override;
+            int getWaitTime() const override;
+            int getDamage(int index, Rng& rng) const override;
+            bool getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const override;
+            int getCastTime(int index) const override;
+            std::string toString(int index) const override {return table->names[index];}
+            bool getDamageBound(int index, double& damage, double& rate) const override {
+                table->bound(index, damage, rate);
+                return true;
+            }
+            std::size_t hash() const override;
+            bool equals(const StateModel& other) const override;
+            std::size_t getSnapshotSize() const override {return values.size() * sizeof(int);}
+            void saveSnapshot(void* snapshot) const override;
+            void loadSnapshot(const void* snapshot) override;
+    };
+
+    TableState::TableState(const std::shared_ptr<const Table>& table): table{table}, values(table->size, 0, Arena::resource()) {
+        for (std::size_t r = 0; r < table->resources.size(); r++) {
+            values[table->amountOffset + r] = table->resources[r].start;
+        }
+    }
+
+    TableState::TableState(const TableState& other):
+        table{other.table}, values{other.values, Arena::resource()} {}
+
+    // The variant the skill is used as in the current state, or nullptr
+    //   if none applies. The methods below read the rows and the state
+    //   through local pointers, so that they are not reloaded.
+    inline const Row* TableState::variant(const Row* rows, const int* v, int index) const {
+        const Row* row = &rows[index];
+        while (row->buff >= 0 && v[row->buff] <= 0) {
+            if (row->next < 0) return nullptr;
+            row = &rows[row->next];
+        }
+        return row;
+    }
+
+    // As Skill::timeUntilReady: the cooldown left, unless the skill
+    //   waits on something else, which the resources and buffs report.
+    //   The skill is ready exactly when this is 0.
+    inline int TableState::timeUntilReady(const Row* rows, const int* v, int index) const {
+        const Row* row = variant(rows, v, index);
+        if (!row) return 3600000;
+        const Effect* e = table->effects.data();
+        for (int i = row->costs; i < row->reductions; i++) {
+            if (v[e[i].target] < e[i].amount) return 3600000;
+        }
+        return row->ignoreCooldown ? 0 : v[index];
+    }
+
+    void TableState::gain(int* v, int resource, int amount) const {
+        int& value = v[table->amountOffset + resource];
+        value += amount;
+        if (value >= table->resources[resource].max) {
+            value = table->resources[resource].max;
+            v[table->timerOffset + resource] = 0;
+        }
+    }
+
+    void TableState::getAvailableSkills(std::vector<int>& indices) const {
+        int numSkills = getNumSkills();
+        const Row* rows = table->rows.data();
+        const int* v = values.data();
+        indices.clear();
+        for (int i = 0; i < numSkills; i++) {
+            if (!timeUntilReady(rows, v, i)) indices.emplace_back(i);
+        }
+    }
+
+    void TableState::useSkill(int index, int time) {
+        const Table& t = *table;
+        int numSkills = t.names.size();
+        int* v = values.data();
+        if (index >= 0) {
+            const Row& used = *variant(t.rows.data(), v, index);
+            const Effect* e = t.effects.data();
+            if (used.cooldown >= 0) v[index] = used.cooldown;
+            for (int i = used.costs; i < used.reductions; i++) v[e[i].target] -= e[i].amount;
+            for (int i = used.reductions; i < used.buffs; i++) {
+                v[e[i].target] = v[e[i].target] < e[i].amount ? 0 : v[e[i].target] - e[i].amount;
+            }
+            for (int i = used.buffs; i < used.ticks; i++) v[e[i].target] = e[i].amount;
+            for (int i = used.ticks; i < used.end; i++) {
+                v[e[i].target] = used.castTime;
+                v[e[i].target + 1] = e[i].amount;
+            }
+        }
+
+        for (int i = 0; i < numSkills; i++) {
+            if (i != index) v[i] = v[i] < time ? 0 : v[i] - time;
+        }
+        for (int b = t.buffOffset; b < t.buffOffset + t.numBuffs; b++) v[b] = v[b] < time ? 0 : v[b] - time;
+        for (std::size_t r = 0; r < t.resources.size(); r++) {
+            const Resource& resource = t.resources[r];
+            int& timer = v[t.timerOffset + r];
+            if (!resource.regen || v[t.amountOffset + r] >= resource.max) continue;
+            timer += time;
+            if (timer >= resource.every) {
+                int gains = timer / resource.every;
+                timer -= gains * resource.every;
+                gain(v, r, gains * resource.regen);
+            }
+        }
+        for (std::size_t k = 0; k < t.ticks.size(); k++) {
+            int& untilTick = v[t.ticksOffset + 2 * k];
+            int& ticksLeft = v[t.ticksOffset + 2 * k + 1];
+            if (!ticksLeft) continue;
+            untilTick -= time;
+            if (untilTick > 0) continue;
+
+            // the tick is gained at the end of the step, if it ends
+            //   before the ticks run out
+            if (-untilTick <= (ticksLeft - 1) * t.ticks[k].every) {
+                gain(v, t.ticks[k].resource, t.ticks[k].amount);
+                ticksLeft--;
+            } else {
+                ticksLeft = 0;
+            }
+            untilTick = ticksLeft ? untilTick + t.ticks[k].every : 0;
+        }
+    }
+
+    int TableState::getWaitTime() const {
+        const Table& t = *table;
+        int numSkills = t.names.size();
+        const Row* rows = t.rows.data();
+        const int* v = values.data();
+        int time = 3600000;
+        for (int i = 0; i < numSkills; i++) {
+            int untilReady = timeUntilReady(rows, v, i);
+            if (untilReady && untilReady < time) time = untilReady;
+        }
+        for (std::size_t r = 0; r < t.resources.size(); r++) {
+            const Resource& resource = t.resources[r];
+            if (!resource.regen || v[t.amountOffset + r] >= resource.max) continue;
+            int untilRegen = resource.every - v[t.timerOffset + r];
+            if (untilRegen < time) time = untilRegen;
+        }
+        for (int b = t.buffOffset; b < t.buffOffset + t.numBuffs; b++) {
+            if (v[b] > 0 && v[b] < time) time = v[b];
+        }
+        for (std::size_t k = 0; k < t.ticks.size(); k++) {
+            int untilTick = v[t.ticksOffset + 2 * k];
+            if (v[t.ticksOffset + 2 * k + 1] && untilTick < time) time = untilTick;
+        }
+        return time;
+    }
+
+    // Outcomes are drawn by a roll from 1 to the total weight, the
+    //   first outcome taking the lowest rolls. Every outcome is looked
+    //   at, so that the roll picks one without a branch.
+    int TableState::getDamage(int index, Rng& rng) const {
+        const Row* row = variant(table->rows.data(), values.data(), index);
+        const Outcome* o = table->outcomes.data();
+        int damage = o[row->outcomes].damage;
+        if (row->outcomesEnd - row->outcomes == 1) return damage;
+        int roll = rng.uniform(1, row->totalWeight);
+        int below = o[row->outcomes].weight;
+        for (int i = row->outcomes + 1; i < row->outcomesEnd; i++) {
+            int past = -(roll > below);
+            damage = (o[i].damage & past) | (damage & ~past);
+            below += o[i].weight;
+        }
+        return damage;
+    }
+
+    bool TableState::getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const {
+        const Row* row = variant(table->rows.data(), values.data(), index);
+        outcomes.clear();
+        for (int i = row->outcomes; i < row->outcomesEnd; i++) {
+            const Outcome& outcome = table->outcomes[i];
+            outcomes.emplace_back(DamageOutcome{outcome.damage, static_cast<double>(outcome.weight) / row->totalWeight});
+        }
+        return true;
+    }
+
+    int TableState::getCastTime(int index) const {
+        const Row* row = variant(table->rows.data(), values.data(), index);
+        return row ? row->castTime : table->rows[index].castTime;
+    }
+
+    std::size_t TableState::hash() const {
+        std::size_t h = 0xcbf29ce484222325ULL;
+        for (int value : values) h = (h ^ static_cast<unsigned>(value)) * 0x100000001b3ULL;
+        return h;
+    }
+
+    bool TableState::equals(const StateModel& other) const {
+        return values == static_cast<const TableState&>(other).values;
+    }
+
+    void TableState::saveSnapshot(void* snapshot) const {
+        std::memcpy(snapshot, values.data(), values.size() * sizeof(int));
+    }
+
+    void TableState::loadSnapshot(const void* snapshot) {
+        std::memcpy(values.data(), snapshot, values.size() * sizeof(int));
+    }
+
+    // The same kit run on a clock, for kits of many skills: instead of
+    //   counting down every cooldown, buff, regen timer and ticks at
+    //   every step, the state holds the time now and the time at which
+    //   each of them next changes something, its timer. Which skills are
+    //   ready is kept as a bitmask, and only the skills reading what a
+    //   step changes (see Table::readers) are looked at again, so that a
+    //   step takes time in the number of changes it makes and of skills
+    //   ready, not in the number of skills. It behaves exactly as the
+    //   TableState of the same kit, and hashes and compares equal to it:
+    //   both are taken over the times left, not the times things happen,
+    //   and so are snapshots.
+    //
+    // The timers are those of the cooldowns of the skills, which run
+    //   only while nothing else keeps the skill from being used, the
+    //   regen of the resources, the buffs and the ticks, in that order.
+    //   They fire at the time never when stopped. The next to fire is
+    //   found from the earliest time of every block of 16 timers, a
+    //   two-level min-heap whose blocks are updated with a few vector
+    //   instructions, which keeps the state much smaller than a binary
+    //   heap with the place of every timer in it, and states are copied
+    //   for every child of a node.
+    //
+    // The array holds the time now, the time each skill comes off
+    //   cooldown, the amounts of the resources, the number of ticks
+    //   left, the bitmask of ready skills, that of the skills to look at
+    //   again and that of the timers firing during a step (both empty
+    //   between steps), the time every timer fires, and the earliest of
+    //   every block.
+    class ClockState final : public StateModel {
+
+        private:
+            static constexpr int never = std::numeric_limits<int>::max();
+            static constexpr int blockSize = 16;
+
+            std::shared_ptr<const Table> table;
+            int numSkills, numResources, numTimers, numBlocks;
+            int buffTimers, tickTimers;
+            int ticksLeftOffset, readyOffset, staleOffset, firingOffset, keyOffset, blockOffset;
+            std::pmr::vector<int> values;
+
+            const Row* variant(const int* v, int index) const;
+            void schedule(int* v, int timer, int time) const;
+            void mark(int* v, int offset, int index) const {v[offset + index / 32] |= 1u << (index % 32);}
+            void markReaders(int* v, int slot) const;
+            void markCosts(int* v, int resource, int from, int to) const;
+            void refresh(int* v, int index) const;
+            void gain(int* v, int resource, int amount) const;
+            void fire(int* v, int timer, int end) const;
+            int value(int slot) const;
+
+        public:
+            explicit ClockState(const std::shared_ptr<const Table>& table);
+            ClockState(const ClockState& other);
+
+            ClockState* copy() const override {return new ClockState{*this};}
+            int getNumSkills() const override {return numSkills;}
+            void getAvailableSkills(std::vector<int>& indices) const override;
+            void useSkill(int index, int time) override;
+            int getWaitTime() const override;
+            int getDamage(int index, Rng& rng) const override;
+            bool getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const override;
+            int getCastTime(int index) const override;
+            std::string toString(int index) const override {return table->names[index];}
+            bool getDamageBound(int index, double& damage, double& rate) const override {
+                table->bound(index, damage, rate);
+                return true;
+            }
+            std::size_t hash() const override;
+            bool equals(const StateModel& other) const override;
+            std::size_t getSnapshotSize() const override {return values.size() * sizeof(int);}
+            void saveSnapshot(void* snapshot) const override;
+            void loadSnapshot(const void* snapshot) override;
+    };
+
+    // The cooldowns and the amounts of the resources are at the same
+    //   places as in the table, shifted by one for the time now, so that
+    //   the targets of the costs and reductions of the rows can be used
+    //   as they are. The timers are padded to whole blocks.
+    ClockState::ClockState(const std::shared_ptr<const Table>& table):
+        table{table}, numSkills{static_cast<int>(table->names.size())},
+        numResources{static_cast<int>(table->resources.size())},
+        numTimers{numSkills + numResources + table->numBuffs + static_cast<int>(table->ticks.size())},
+        numBlocks{(numTimers + blockSize - 1) / blockSize}, buffTimers{numSkills + numResources},
+        tickTimers{buffTimers + table->numBuffs}, ticksLeftOffset{1 + numSkills + numResources},
+        readyOffset{ticksLeftOffset + static_cast<int>(table->ticks.size())},
+        staleOffset{readyOffset + (numSkills + 31) / 32}, firingOffset{staleOffset + (numSkills + 31) / 32},
+        keyOffset{firingOffset + (numTimers + 31) / 32}, blockOffset{keyOffset + numBlocks * blockSize},
+        values(blockOffset + numBlocks, 0, Arena::resource()) {
+        int* v = values.data();
+        std::fill(v + keyOffset, v + blockOffset + numBlocks, never);
+        for (int r = 0; r < numResources; r++) {
+            const Resource& resource = table->resources[r];
+            v[1 + numSkills + r] = resource.start;
+            if (resource.regen && resource.start < resource.max) schedule(v, numSkills + r, resource.every);
+        }
+        for (int i = 0; i < numSkills; i++) refresh(v, i);
+    }
+
+    ClockState::ClockState(const ClockState& other):
+        table{other.table}, numSkills{other.numSkills}, numResources{other.numResources},
+        numTimers{other.numTimers}, numBlocks{other.numBlocks}, buffTimers{other.buffTimers},
+        tickTimers{other.tickTimers}, ticksLeftOffset{other.ticksLeftOffset}, readyOffset{other.readyOffset},
+        staleOffset{other.staleOffset}, firingOffset{other.firingOffset}, keyOffset{other.keyOffset},
+        blockOffset{other.blockOffset}, values{other.values, Arena::resource()} {}
+
+    // A buff is up exactly while its timer runs
+    inline const Row* ClockState::variant(const int* v, int index) const {
+        const Row* rows = table->rows.data();
+        const Row* row = &rows[index];
+        const int* buffKeys = v + keyOffset + buffTimers - table->buffOffset;
+        while (row->buff >= 0 && buffKeys[row->buff] == never) {
+            if (row->next < 0) return nullptr;
+            row = &rows[row->next];
+        }
+        return row;
+    }
+
+    void ClockState::schedule(int* v, int timer, int time) const {
+        int* keys = v + keyOffset;
+        int& earliest = v[blockOffset + timer / blockSize];
+        int old = keys[timer];
+        keys[timer] = time;
+        if (time <= earliest) {
+            earliest = time;
+        } else if (old == earliest) {
+            const int* block = keys + timer / blockSize * blockSize;
+            int first = never;
+            for (int i = 0; i < blockSize; i++) first = std::min(first, block[i]);
+            earliest = first;
+        }
+    }
+
+    inline void ClockState::markReaders(int* v, int slot) const {
+        const int* readers = table->readers.data();
+        for (int i = table->readerOffsets[slot]; i < table->readerOffsets[slot + 1]; i++) mark(v, staleOffset, readers[i]);
+    }
+
+    // Mark the skills with a cost on the resource that the amount went
+    //   past, going from one amount to the other
+    inline void ClockState::markCosts(int* v, int resource, int from, int to) const {
+        const Effect* first = table->costs.data() + table->costOffsets[resource];
+        const Effect* last = table->costs.data() + table->costOffsets[resource + 1];
+        int low = std::min(from, to), high = std::max(from, to);
+        const Effect* cost = std::upper_bound(first, last, low, [](int amount, const Effect& c) {return amount < c.amount;});
+        for (; cost != last && cost->amount <= high; cost++) mark(v, staleOffset, cost->target);
+    }
+
+    // Work out again whether the skill is ready, and when its cooldown
+    //   timer fires: when its cooldown ends, if that is the only thing
+    //   keeping it from being used, otherwise never, as with the
+    //   TableState::timeUntilReady it stands for
+    void ClockState::refresh(int* v, int index) const {
+        int now = v[0];
+        const Row* row = variant(v, index);
+        bool affordable = row;
+        if (row) {
+            const Effect* e = table->effects.data();
+            for (int i = row->costs; i < row->reductions && affordable; i++) affordable = v[1 + e[i].target] >= e[i].amount;
+        }
+        bool offCooldown = row && (row->ignoreCooldown || v[1 + index] <= now);
+        unsigned bit = 1u << (index % 32);
+        int& word = v[readyOffset + index / 32];
+        word = affordable && offCooldown ? word | bit : word & ~bit;
+        int time = affordable && !offCooldown ? v[1 + index] : never;
+        if (v[keyOffset + index] != time) schedule(v, index, time);
+    }
+
+    void ClockState::gain(int* v, int resource, int amount) const {
+        int& value = v[1 + numSkills + resource];
+        int from = value;
+        value += amount;
+        if (value >= table->resources[resource].max) {
+            value = table->resources[resource].max;
+            schedule(v, numSkills + resource, never);
+        }
+        markCosts(v, resource, from, value);
+    }
+
+    // Handle the timer firing during the step ending at the given time,
+    //   as the TableState counts it down: a regen gains once for every
+    //   full period, and ticks once however many periods went by. Timers
+    //   are handled in order, so regens come before the ticks that may
+    //   stop them.
+    void ClockState::fire(int* v, int timer, int end) const {
+        const Table& t = *table;
+        int key = v[keyOffset + timer];
+        if (timer < numSkills) {
+            schedule(v, timer, never);
+            mark(v, staleOffset, timer);
+        } else if (timer < buffTimers) {
+            int r = timer - numSkills;
+            int every = t.resources[r].every;
+            int gains = (end - key) / every + 1;
+            schedule(v, timer, key + gains * every);
+            gain(v, r, gains * t.resources[r].regen);
+        } else if (timer < tickTimers) {
+            schedule(v, timer, never);
+            markReaders(v, t.buffOffset + timer - buffTimers);
+        } else {
+            int k = timer - tickTimers;
+            int& ticksLeft = v[ticksLeftOffset + k];
+            if (end - key <= (ticksLeft - 1) * t.ticks[k].every) {
+                ticksLeft--;
+                gain(v, t.ticks[k].resource, t.ticks[k].amount);
+            } else {
+                ticksLeft = 0;
+            }
+            schedule(v, timer, ticksLeft ? key + t.ticks[k].every : never);
+        }
+    }
+
+    void ClockState::getAvailableSkills(std::vector<int>& indices) const {
+        const int* ready = values.data() + readyOffset;
+        indices.clear();
+        for (int w = 0; w < staleOffset - readyOffset; w++) {
+            for (unsigned bits = ready[w]; bits; bits &= bits - 1) indices.emplace_back(32 * w + __builtin_ctz(bits));
+        }
+    }
+
+    // As TableState::useSkill, with the times left taken from now. The
+    //   timers firing during the step are all found first, so that each
+    //   is handled once per step as the TableState does, even if it
+    //   fires again before the end of the step.
+    void ClockState::useSkill(int index, int time) {
+        const Table& t = *table;
+        int* v = values.data();
+        int now = v[0];
+        int end = now + time;
+        if (index >= 0) {
+            const Row& used = *variant(v, index);
+            const Effect* e = t.effects.data();
+            if (used.cooldown >= 0) v[1 + index] = now + used.cooldown;
+            for (int i = used.costs; i < used.reductions; i++) {
+                int resource = e[i].target - t.amountOffset;
+                int& amount = v[1 + e[i].target];
+                amount -= e[i].amount;
+                if (v[keyOffset + numSkills + resource] == never && t.resources[resource].regen &&
+                    amount < t.resources[resource].max) {
+                    schedule(v, numSkills + resource, now + t.resources[resource].every);
+                }
+                markCosts(v, resource, amount + e[i].amount, amount);
+            }
+            for (int i = used.reductions; i < used.buffs; i++) {
+                int& readyAt = v[1 + e[i].target];
+                readyAt = readyAt - now < e[i].amount ? now : readyAt - e[i].amount;
+                mark(v, staleOffset, e[i].target);
+            }
+            for (int i = used.buffs; i < used.ticks; i++) {
+                schedule(v, buffTimers + e[i].target - t.buffOffset, now + e[i].amount);
+                markReaders(v, e[i].target);
+            }
+            for (int i = used.ticks; i < used.end; i++) {
+                int k = (e[i].target - t.ticksOffset) / 2;
+                schedule(v, tickTimers + k, now + used.castTime);
+                v[ticksLeftOffset + k] = e[i].amount;
+            }
+
+            // the skill used does not wait for its own cast
+            if (v[1 + index] > now) v[1 + index] += time;
+            mark(v, staleOffset, index);
+        }
+        v[0] = end;
+
+        const int* keys = v + keyOffset;
+        for (int b = 0; b < numBlocks; b++) {
+            if (v[blockOffset + b] > end) continue;
+            for (int timer = b * blockSize; timer < (b + 1) * blockSize; timer++) {
+                if (keys[timer] <= end) mark(v, firingOffset, timer);
+            }
+        }
+        for (int w = firingOffset; w < keyOffset; w++) {
+            for (unsigned bits = v[w]; bits; bits &= bits - 1) fire(v, 32 * (w - firingOffset) + __builtin_ctz(bits), end);
+            v[w] = 0;
+        }
+        for (int w = staleOffset; w < firingOffset; w++) {
+            for (unsigned bits = v[w]; bits; bits &= bits - 1) refresh(v, 32 * (w - staleOffset) + __builtin_ctz(bits));
+            v[w] = 0;
+        }
+    }
+
+    int ClockState::getWaitTime() const {
+        const int* earliest = values.data() + blockOffset;
+        int next = never;
+        for (int b = 0; b < numBlocks; b++) next = std::min(next, earliest[b]);
+        return next == never || next - values[0] > 3600000 ? 3600000 : next - values[0];
+    }
+
+    int ClockState::getDamage(int index, Rng& rng) const {
+        const Row* row = variant(values.data(), index);
+        const Outcome* o = table->outcomes.data();
+        int damage = o[row->outcomes].damage;
+        if (row->outcomesEnd - row->outcomes == 1) return damage;
+        int roll = rng.uniform(1, row->totalWeight);
+        int below = o[row->outcomes].weight;
+        for (int i = row->outcomes + 1; i < row->outcomesEnd; i++) {
+            int past = -(roll > below);
+            damage = (o[i].damage & past) | (damage & ~past);
+            below += o[i].weight;
+        }
+        return damage;
+    }
+
+    bool ClockState::getDamageDistribution(int index, std::vector<DamageOutcome>& outcomes) const {
+        const Row* row = variant(values.data(), index);
+        outcomes.clear();
+        for (int i = row->outcomes; i < row->outcomesEnd; i++) {
+            const Outcome& outcome = table->outcomes[i];
+            outcomes.emplace_back(DamageOutcome{outcome.damage, static_cast<double>(outcome.weight) / row->totalWeight});
+        }
+        return true;
+    }
+
+    int ClockState::getCastTime(int index) const {
+        const Row* row = variant(values.data(), index);
+        return row ? row->castTime : table->rows[index].castTime;
+    }
+
+    // The value the TableState of the kit holds at the given slot
+    int ClockState::value(int slot) const {
+        const Table& t = *table;
+        const int* v = values.data();
+        int now = v[0];
+        if (slot < t.timerOffset) return slot < numSkills ? std::max(v[1 + slot] - now, 0) : v[1 + slot];
+        if (slot < t.buffOffset) {
+            int key = v[keyOffset + numSkills + slot - t.timerOffset];
+            return key == never ? 0 : t.resources[slot - t.timerOffset].every - (key - now);
+        }
+        if (slot < t.ticksOffset) {
+            int key = v[keyOffset + buffTimers + slot - t.buffOffset];
+            return key == never ? 0 : key - now;
+        }
+        int k = (slot - t.ticksOffset) / 2;
+        int ticksLeft = v[ticksLeftOffset + k];
+        if ((slot - t.ticksOffset) % 2) return ticksLeft;
+        return ticksLeft ? v[keyOffset + tickTimers + k] - now : 0;
+    }
+
+    std::size_t ClockState::hash() const {
+        std::size_t h = 0xcbf29ce484222325ULL;
+        for (int slot = 0; slot < table->size; slot++) h = (h ^ static_cast<unsigned>(value(slot))) * 0x100000001b3ULL;
+        return h;
+    }
+
+    bool ClockState::equals(const StateModel& other) const {
+        const ClockState& o = static_cast<const ClockState&>(other);
+        for (int slot = 0; slot < table->size; slot++) {
+            if (value(slot) != o.value(slot)) return false;
+        }
+        return true;
+    }
+
+    // Snapshots are taken with the clock set back to 0, and cooldowns
+    //   that have ended ending then, so that two snapshots are equal
+    //   exactly when the states compare equal
+    void ClockState::saveSnapshot(void* snapshot) const {
+        char* out = static_cast<char*>(snapshot);
+        int now = values[0];
+        for (int i = 0; i < static_cast<int>(values.size()); i++) {
+            int value = values[i];
+            if (i <= numSkills) value = std::max(value - now, 0);
+            else if (i >= keyOffset && value != never) value -= now;
+            std::memcpy(out + i * sizeof(int), &value, sizeof(int));
+        }
+    }
+
+    void ClockState::loadSnapshot(const void* snapshot) {
+        std::memcpy(values.data(), snapshot, values.size() * sizeof(int));
+    }
+
+    // A line of the file, split into its keyword, name and settings
+    struct Line {
+        int number;
+        std::string keyword;
+        std::string name;
+        std::vector<std::pair<std::string, std::string>> settings;
+    };
+
+    bool toInt(const std::string& s, int& value) {
+        try {
+            std::size_t end = 0;
+            value = std::stoi(s, &end);
+            return end == s.size();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> split(const std::string& s, char separator) {
+        std::vector<std::string> parts;
+        std::istringstream in{s};
+        for (std::string part; std::getline(in, part, separator);) parts.emplace_back(part);
+        return parts;
+    }
+
+    // Reads every setting of the kit into the table, from the lines
+    //   split and the names declared by them
+    class Parser final {
+        private:
+            std::unordered_map<std::string, int> skills, resources, buffs, ticks;
+            std::string& error;
+
+            bool find(const std::unordered_map<std::string, int>& names, const std::string& kind,
+                      const std::string& name, int& index);
+            bool effects(const std::unordered_map<std::string, int>& names, const std::string& kind,
+                         const std::string& value, std::vector<Effect>& effects);
+            bool parseSkill(const Line& line, Variant& variant);
+            bool parseResource(const Line& line, Resource& resource);
+            bool parseTicks(const Line& line, Ticks& ticks);
+
+        public:
+            explicit Parser(std::string& error): error{error} {}
+            std::unique_ptr<Table> parse(const std::vector<Line>& lines);
+    };
+
+    bool Parser::find(const std::unordered_map<std::string, int>& names, const std::string& kind,
+                      const std::string& name, int& index) {
+        auto it = names.find(name);
+        if (it == names.end()) {
+            error = "unknown " + kind + " " + name;
+            return false;
+        }
+        index = it->second;
+        return true;
+    }
+
+    // Reads a list of NAME:N, where N may be left out for skills being
+    //   reset
+    bool Parser::effects(const std::unordered_map<std::string, int>& names, const std::string& kind,
+                         const std::string& value, std::vector<Effect>& effects) {
+        for (const std::string& item : split(value, ',')) {
+            std::vector<std::string> parts = split(item, ':');
+            Effect effect{0, 3600000};
+            if (parts.empty() || parts.size() > 2 || !find(names, kind, parts[0], effect.target)) {
+                if (error.empty()) error = "expected " + kind + ":N, got " + item;
+                return false;
+            }
+            if (parts.size() == 2 && (!toInt(parts[1], effect.amount) || effect.amount < 0)) {
+                error = "invalid amount in " + item;
+                return false;
+            }
+            if (parts.size() == 1 && kind != "skill to reset") {
+                error = "expected " + kind + ":N, got " + item;
+                return false;
+            }
+            effects.emplace_back(effect);
+        }
+        return true;
+    }
+
+    bool Parser::parseSkill(const Line& line, Variant& variant) {
+        for (const auto& [key, value] : line.settings) {
+            bool valid = true;
+            if (key == "if") valid = find(buffs, "buff", value, variant.buff);
+            else if (key == "cast") valid = toInt(value, variant.castTime) && variant.castTime > 0;
+            else if (key == "cooldown") valid = toInt(value, variant.cooldown) && variant.cooldown >= 0;
+            else if (key == "ignore-cooldown") variant.ignoreCooldown = value != "0";
+            else if (key == "cost") valid = effects(resources, "resource", value, variant.costs);
+            else if (key == "buff") valid = effects(buffs, "buff", value, variant.buffs);
+            else if (key == "reduces") valid = effects(skills, "skill", value, variant.reductions);
+            else if (key == "resets") valid = effects(skills, "skill to reset", value, variant.reductions);
+            else if (key == "ticks") {
+                for (const std::string& name : split(value, ',')) {
+                    variant.ticks.emplace_back();
+                    if (!(valid = find(ticks, "ticks", name, variant.ticks.back()))) break;
+                }
+            } else if (key == "damage") {
+                for (const std::string& item : split(value, ',')) {
+                    std::vector<std::string> parts = split(item, ':');
+                    Outcome outcome{0, 1};
+                    valid = !parts.empty() && parts.size() <= 2 && toInt(parts[0], outcome.damage) &&
+                        (parts.size() == 1 || (toInt(parts[1], outcome.weight) && outcome.weight > 0));
+                    if (!valid) break;
+                    variant.outcomes.emplace_back(outcome);
+                    variant.totalWeight += outcome.weight;
+                }
+            } else {
+                error = "unknown setting " + key;
+                return false;
+            }
+            if (!valid) {
+                if (error.empty()) error = "invalid setting " + key + "=" + value;
+                return false;
+            }
+        }
+        if (variant.castTime <= 0) {
+            error = "skill " + line.name + " has no cast time";
+            return false;
+        }
+        if (variant.outcomes.empty()) {
+            variant.outcomes.emplace_back(Outcome{0, 1});
+            variant.totalWeight = 1;
+        }
+        return true;
+    }
+
+    bool Parser::parseResource(const Line& line, Resource& resource) {
+        for (const auto& [key, value] : line.settings) {
+            int* field = key == "start" ? &resource.start : key == "max" ? &resource.max :
+                key == "regen" ? &resource.regen : key == "every" ? &resource.every : nullptr;
+            if (!field) {
+                error = "unknown setting " + key;
+                return false;
+            }
+            if (!toInt(value, *field) || *field < 0) {
+                error = "invalid setting " + key + "=" + value;
+                return false;
+            }
+        }
+        if (resource.every <= 0 || resource.start > resource.max) {
+            error = "resource " + line.name + " must have every > 0 and start <= max";
+            return false;
+        }
+        return true;
+    }
+
+    bool Parser::parseTicks(const Line& line, Ticks& t) {
+        for (const auto& [key, value] : line.settings) {
+            bool valid = true;
+            if (key == "resource") valid = find(resources, "resource", value, t.resource);
+            else if (key == "amount") valid = toInt(value, t.amount);
+            else if (key == "every") valid = toInt(value, t.every);
+            else if (key == "for") valid = toInt(value, t.duration);
+            else {
+                error = "unknown setting " + key;
+                return false;
+            }
+            if (!valid) {
+                if (error.empty()) error = "invalid setting " + key + "=" + value;
+                return false;
+            }
+        }
+        if (t.resource < 0 || t.every <= 0 || t.duration < 0 || t.duration % t.every != 0) {
+            error = "ticks " + line.name + " needs a resource, and for= a multiple of every= > 0";
+            return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<Table> Parser::parse(const std::vector<Line>& lines) {
+        auto table = std::make_unique<Table>();
+
+        // declare every name first, so that lines may refer to names
+        //   declared further down
+        std::vector<std::vector<const Line*>> variants;
+        for (const Line& line : lines) {
+            auto declare = [&](std::unordered_map<std::string, int>& names) {
+                if (names.count(line.name)) {
+                    error = "line " + std::to_string(line.number) + ": " + line.keyword + " " + line.name +
+                        " declared twice";
+                    return false;
+                }
+                names.emplace(line.name, names.size());
+                return true;
+            };
+            if (line.keyword == "skill") {
+                if (!skills.count(line.name)) {
+                    skills.emplace(line.name, skills.size());
+                    table->names.emplace_back(line.name);
+                    variants.emplace_back();
+                }
+                variants[skills[line.name]].emplace_back(&line);
+            } else if (line.keyword == "resource" || line.keyword == "buff" || line.keyword == "ticks") {
+                if (!declare(line.keyword == "resource" ? resources : line.keyword == "buff" ? buffs : ticks)) {
+                    return nullptr;
+                }
+            } else {
+                error = "line " + std::to_string(line.number) + ": unknown keyword " + line.keyword;
+                return nullptr;
+            }
+        }
+        if (skills.empty()) {
+            error = "no skills";
+            return nullptr;
+        }
+
+        table->resources.resize(resources.size());
+        table->ticks.resize(ticks.size());
+        table->numBuffs = buffs.size();
+        for (const Line& line : lines) {
+            bool valid = true;
+            if (line.keyword == "resource") valid = parseResource(line, table->resources[resources[line.name]]);
+            else if (line.keyword == "ticks") valid = parseTicks(line, table->ticks[ticks[line.name]]);
+            else if (line.keyword == "buff" && !line.settings.empty()) {
+                error = "unknown setting " + line.settings[0].first;
+                valid = false;
+            }
+            if (!valid) {
+                error = "line " + std::to_string(line.number) + ": " + error;
+                return nullptr;
+            }
+        }
+        table->amountOffset = table->names.size();
+        table->timerOffset = table->amountOffset + table->resources.size();
+        table->buffOffset = table->timerOffset + table->resources.size();
+        table->ticksOffset = table->buffOffset + table->numBuffs;
+        table->size = table->ticksOffset + 2 * table->ticks.size();
+
+        table->rows.resize(table->names.size(), Row{-1, 0, -1, false, 0, 0, 0, 0, 0, 0, 0, 0, -1});
+        for (std::size_t i = 0; i < variants.size(); i++) {
+            for (const Line* line : variants[i]) {
+                Variant variant;
+                if (!parseSkill(*line, variant)) {
+                    error = "line " + std::to_string(line->number) + ": " + error;
+                    return nullptr;
+                }
+                table->add(i, variant);
+            }
+        }
+        table->link();
+        return table;
+    }
+}
+
+std::unique_ptr<State> TableKit::load(const std::string& path, std::string& error, bool clock) {
+    std::ifstream file{path};
+    if (!file) {
+        error = "could not open " + path;
+        return nullptr;
+    }
+    std::unique_ptr<State> state = parse(file, error, clock);
+    if (!state) error = path + ": " + error;
+    return state;
+}
+
+std::unique_ptr<State> TableKit::parse(std::istream& in, std::string& error, bool clock) {
+    std::vector<Line> lines;
+    std::string text;
+    for (int number = 1; std::getline(in, text); number++) {
+        std::istringstream tokens{text.substr(0, text.find('#'))};
+        Line line{number, "", "", {}};
+        if (!(tokens >> line.keyword)) continue;
+        if (!(tokens >> line.name) || line.name.find('=') != std::string::npos) {
+            error = "line " + std::to_string(number) + ": expected a name after " + line.keyword;
+            return nullptr;
+        }
+        for (std::string token; tokens >> token;) {
+            std::size_t equals = token.find('=');
+            if (equals == std::string::npos) {
+                error = "line " + std::to_string(number) + ": expected key=value, got " + token;
+                return nullptr;
+            }
+            line.settings.emplace_back(token.substr(0, equals), token.substr(equals + 1));
+        }
+        lines.emplace_back(std::move(line));
+    }
+
+    // the table is shared by every copy of the state, and freed with
+    //   the last of them
+    error.clear();
+    std::shared_ptr<const Table> table = Parser{error}.parse(lines);
+    if (!table) return nullptr;
+    std::unique_ptr<State> state = std::make_unique<State>();
+    if (clock) state->setModel(std::make_unique<ClockState>(table));
+    else state->setModel(std::make_unique<TableState>(table));
+    return state;
+}
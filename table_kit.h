@@ -0,0 +1,75 @@
+#ifndef _TABLE_KIT_H_
+#define _TABLE_KIT_H_
+
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "state.h"
+
+// Kits described in a text file instead of Skill and Resources classes
+//   (see kits/bm.kit, which describes the BM kit of bm.cc), so that a
+//   new character needs no rebuild. The kit is loaded into flat tables
+//   shared by every copy of the state, and run by a StateModel whose
+//   state is a single array of integers, so that using a skill is a
+//   few loops over arrays with no virtual call per skill.
+//
+// Every line declares one thing, by a keyword and a name followed by
+//   space-separated key=value settings. Blank lines and everything
+//   after a '#' are ignored. Names may be used before the line that
+//   declares them.
+//
+//     resource NAME start=N max=N regen=N every=MS
+//         A resource starting at start, never above max, which gains
+//         regen every every milliseconds spent below max, counted from
+//         when it drops below max. All but start are optional.
+//
+//     buff NAME
+//         A buff, up while the time set by the last skill applying it
+//         has not run out.
+//
+//     ticks NAME resource=NAME amount=N every=MS for=MS
+//         Gains of amount of the resource when a skill triggers it, at
+//         the end of its cast and then every every milliseconds, for
+//         for milliseconds (a multiple of every). A tick falling during
+//         a cast is gained at its end, if that is within the for
+//         milliseconds. Triggering it again starts it over.
+//
+//     skill NAME [if=BUFF] cast=MS cooldown=MS ignore-cooldown=1
+//                cost=RESOURCE:N,... damage=D:W,... buff=BUFF:MS,...
+//                ticks=TICKS,... reduces=SKILL:MS,... resets=SKILL,...
+//         A variant of the skill of that name: the skill is used as the
+//         first of its variants whose buff is up, or whose line has no
+//         if=, and cannot be used if there is none. The variant takes
+//         cast milliseconds to cast, sets the cooldown of the skill if
+//         given, and can be used on cooldown with ignore-cooldown=1. It
+//         needs and spends the costs, deals D damage with weight W (1
+//         if left out) for each outcome, applies the buffs for the
+//         given time from the start of its cast, triggers the ticks,
+//         and reduces or resets the cooldowns of other skills. Skills
+//         are indexed in the order of their first line.
+//
+// A skill is used as with Skill and Resources objects: its cooldown is
+//   set, the cooldowns it reduces or resets are, its costs are spent,
+//   its buffs applied and its ticks triggered, then everything but the
+//   skill itself waits for the cast time, cooldowns and buffs first,
+//   then the resources and ticks in the order they were declared.
+//
+// The kit can be run by either of two state models, which behave
+//   identically. The first counts down every cooldown, buff and timer
+//   at every step. The second keeps the time at which each of them
+//   runs out instead, in a heap, and which skills are ready as a
+//   bitmask, so that a step only looks at what changes during it. It
+//   is faster for kits of many skills, and the first for kits of a few.
+struct TableKit {
+
+    // Return the initial state of the kit in the given file, or nullptr
+    //   with the error set to what is wrong with it, and where. The
+    //   state is run on a clock (see above) if clock is true.
+    static std::unique_ptr<State> load(const std::string& path, std::string& error, bool clock = false);
+
+    // The same, reading the kit from the given stream
+    static std::unique_ptr<State> parse(std::istream& in, std::string& error, bool clock = false);
+};
+
+#endif